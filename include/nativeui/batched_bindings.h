@@ -0,0 +1,178 @@
+// Copyright 2018 Cheng Zhao. All rights reserved.
+// Use of this source code is governed by the license that can be found in the
+// LICENSE file.
+
+#ifndef NATIVEUI_BATCHED_BINDINGS_H_
+#define NATIVEUI_BATCHED_BINDINGS_H_
+
+#include <functional>
+#include <string>
+#include <unordered_map>
+#include <utility>
+
+#include "base/base64.h"
+#include "base/json/string_escape.h"
+#include "base/strings/string_piece.h"
+#include "nativeui/browser.h"
+#include "nativeui/util/binary_data.h"
+
+namespace nu {
+
+// Native bindings whose calls are batched: the page queues calls made with
+//
+//   window.<binding name>.batch('name', arg1, arg2, ...)
+//
+// and sends everything queued in the same task as one message, after which
+// each call is dispatched like Browser::AddBinding() would. ArrayBuffers and
+// typed arrays are sent as binary data, received by BinaryData arguments.
+//
+// In the other direction, Push() sends a buffer to the listener registered
+// with window.<binding name>.onPush(channel, callback), as an ArrayBuffer.
+//
+// The helper script defining them is injected with ExecuteJavaScript()
+// whenever the browser commits a navigation, so it can run after the first
+// scripts of the page. Pages calling batch() or onPush() before they load
+// include GetStubScript() first, e.g. inlined at the top of <head>: it queues
+// the calls, which the helper replays in order once injected.
+class BatchedBindings {
+ public:
+  using BindingFunc = Browser::BindingFunc;
+
+  // Name of the raw binding receiving the batches.
+  static constexpr const char* kBatchBinding = "__nuBatch";
+
+  // |binding_name| is the name already set with Browser::SetBindingName(),
+  // which is left as is. |browser| must outlive this object.
+  BatchedBindings(Browser* browser, const std::string& binding_name)
+      : browser_(browser), binding_name_(binding_name) {
+    browser_->AddRawBinding(kBatchBinding,
+                            [this](Browser* browser, base::Value args) {
+      Dispatch(browser, std::move(args));
+    });
+    on_commit_id_ = browser_->on_commit_navigation.Connect(
+        [this](Browser*, const std::string&) { InjectScript(); });
+    InjectScript();
+  }
+
+  ~BatchedBindings() {
+    browser_->on_commit_navigation.Disconnect(on_commit_id_);
+    browser_->RemoveBinding(kBatchBinding);
+  }
+
+  void AddRawBinding(const std::string& name, const BindingFunc& func) {
+    bindings_[name] = func;
+  }
+
+  void RemoveBinding(const std::string& name) { bindings_.erase(name); }
+
+  // Automatically deduce argument types.
+  template<typename Sig>
+  void AddBinding(const std::string& name, const std::function<Sig>& func) {
+    AddRawBinding(name, [func](nu::Browser* browser, base::Value args) {
+      internal::Dispatcher<Sig>::DispatchToCallback(
+          func, browser, std::move(args));
+    });
+  }
+  // Automatically convert function pointer to std::function.
+  template<typename T>
+  void AddBinding(const std::string& name, T func) {
+    using RunType = typename internal::FunctorTraits<T>::RunType;
+    AddBinding(name, std::function<RunType>(func));
+  }
+
+  // Send |size| bytes to the page's listener of |channel|.
+  void Push(const std::string& channel, const void* data, size_t size) {
+    std::string encoded;
+    base::Base64Encode(
+        base::StringPiece(static_cast<const char*>(data), size), &encoded);
+    browser_->ExecuteJavaScript(
+        "window." + binding_name_ + ".__nuDeliver(" +
+            base::GetQuotedJSONString(channel) + ",'" + encoded + "')",
+        [](bool, base::Value) {});
+  }
+
+  // The script defining batch(), onPush() and the receiving end of Push().
+  std::string GetScript() const {
+    return
+        "(function() {\n"
+        "  var b = window." + binding_name_ + ";\n"
+        "  if (!b || b.__nuBatchReady) return;\n"
+        "  var early = b.__nuEarly || [];\n"
+        "  var queue = [], listeners = {};\n"
+        "  function encode(v) {\n"
+        "    if (v instanceof ArrayBuffer) v = new Uint8Array(v);\n"
+        "    else if (ArrayBuffer.isView(v))\n"
+        "      v = new Uint8Array(v.buffer, v.byteOffset, v.byteLength);\n"
+        "    else return v;\n"
+        "    var s = '';\n"
+        "    for (var i = 0; i < v.length; i += 0x8000)\n"
+        "      s += String.fromCharCode.apply(null, v.subarray(i, i + 0x8000));\n"
+        "    return {'" + std::string(BinaryData::kKey) + "': btoa(s)};\n"
+        "  }\n"
+        "  function flush() {\n"
+        "    var calls = queue;\n"
+        "    queue = [];\n"
+        "    b." + std::string(kBatchBinding) + "(calls);\n"
+        "  }\n"
+        "  b.batch = function(name) {\n"
+        "    var args = Array.prototype.slice.call(arguments, 1).map(encode);\n"
+        "    if (queue.push([name, args]) == 1) Promise.resolve().then(flush);\n"
+        "  };\n"
+        "  b.onPush = function(channel, callback) {\n"
+        "    listeners[channel] = callback;\n"
+        "  };\n"
+        "  b.__nuDeliver = function(channel, data) {\n"
+        "    var s = atob(data), a = new Uint8Array(s.length);\n"
+        "    for (var i = 0; i < s.length; ++i) a[i] = s.charCodeAt(i);\n"
+        "    if (listeners[channel]) listeners[channel](a.buffer);\n"
+        "  };\n"
+        "  b.__nuBatchReady = true;\n"
+        "  delete b.__nuEarly;\n"
+        "  early.forEach(function(c) { b[c[0]].apply(b, c[1]); });\n"
+        "})();";
+  }
+
+  // The script for pages to run before their first use of batch() and
+  // onPush(), queuing the calls made before the helper is injected.
+  std::string GetStubScript() const {
+    return
+        "(function() {\n"
+        "  var b = window." + binding_name_ + ";\n"
+        "  if (!b || b.batch) return;\n"
+        "  var early = b.__nuEarly = [];\n"
+        "  b.batch = function() { early.push(['batch', arguments]); };\n"
+        "  b.onPush = function() { early.push(['onPush', arguments]); };\n"
+        "})();";
+  }
+
+ private:
+  void InjectScript() {
+    browser_->ExecuteJavaScript(GetScript(), [](bool, base::Value) {});
+  }
+
+  // |args| holds one list of [name, [args...]] pairs.
+  void Dispatch(Browser* browser, base::Value args) {
+    if (!args.is_list() || args.GetList().empty() ||
+        !args.GetList()[0].is_list())
+      return;
+    for (base::Value& call : args.GetList()[0].GetList()) {
+      if (!call.is_list() || call.GetList().size() != 2 ||
+          !call.GetList()[0].is_string() || !call.GetList()[1].is_list())
+        continue;
+      auto it = bindings_.find(call.GetList()[0].GetString());
+      if (it != bindings_.end())
+        it->second(browser, std::move(call.GetList()[1]));
+    }
+  }
+
+  Browser* browser_;
+  std::string binding_name_;
+  std::unordered_map<std::string, BindingFunc> bindings_;
+  int on_commit_id_;
+
+  DISALLOW_COPY_AND_ASSIGN(BatchedBindings);
+};
+
+}  // namespace nu
+
+#endif  // NATIVEUI_BATCHED_BINDINGS_H_
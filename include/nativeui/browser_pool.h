@@ -0,0 +1,103 @@
+// Copyright 2018 Cheng Zhao. All rights reserved.
+// Use of this source code is governed by the license that can be found in the
+// LICENSE file.
+
+#ifndef NATIVEUI_BROWSER_POOL_H_
+#define NATIVEUI_BROWSER_POOL_H_
+
+#include <functional>
+#include <utility>
+#include <vector>
+
+#include "base/memory/weak_ptr.h"
+#include "nativeui/browser.h"
+#include "nativeui/message_loop.h"
+
+namespace nu {
+
+// Keep browsers created ahead of time, since creating a web view is slow.
+//
+// The pool fills itself with idle-priority tasks, one browser per task, so
+// it does not hold up startup or input. Each browser loads a blank page to
+// start its web process, and is passed to |setup| to install the binding
+// name and bindings. Protocol handlers are global, so they only need to be
+// registered once before Fill().
+//
+// Lease() returns a pooled browser at once, or creates one if the pool is
+// empty, and refills the pool. Leased browsers are not given back: a lessee
+// can change bindings, the binding name, the user agent and connect to any of
+// the browser's and view's signals, none of which can be reliably reverted,
+// so a leased browser is simply dropped when the lessee is done with it.
+//
+// Must be used on the GUI thread.
+class BrowserPool {
+ public:
+  using SetupCallback = std::function<void(Browser*)>;
+
+  BrowserPool(const Browser::Options& options,
+              size_t size,
+              const SetupCallback& setup = SetupCallback())
+      : options_(options), size_(size), setup_(setup), weak_factory_(this) {}
+
+  ~BrowserPool() = default;
+
+  // Start filling the pool in the background.
+  void Fill() {
+    if (filling_ || browsers_.size() >= size_)
+      return;
+    filling_ = true;
+    MessageLoop::PostTask(
+        MessageLoop::TaskPriority::kIdle,
+        base::BindOnce(&BrowserPool::FillOne, weak_factory_.GetWeakPtr()));
+  }
+
+  scoped_refptr<Browser> Lease() {
+    scoped_refptr<Browser> browser;
+    if (browsers_.empty()) {
+      browser = Create();
+    } else {
+      browser = std::move(browsers_.back());
+      browsers_.pop_back();
+    }
+    Fill();
+    return browser;
+  }
+
+  // Number of browsers ready to be leased.
+  size_t available() const { return browsers_.size(); }
+  size_t size() const { return size_; }
+
+ private:
+  static constexpr const char* kBlankURL = "about:blank";
+
+  scoped_refptr<Browser> Create() {
+    scoped_refptr<Browser> browser(new Browser(options_));
+    browser->LoadURL(kBlankURL);
+    if (setup_)
+      setup_(browser.get());
+    return browser;
+  }
+
+  void FillOne() {
+    filling_ = false;
+    if (browsers_.size() >= size_)
+      return;
+    browsers_.push_back(Create());
+    Fill();
+  }
+
+  const Browser::Options options_;
+  const size_t size_;
+  SetupCallback setup_;
+
+  std::vector<scoped_refptr<Browser>> browsers_;
+  bool filling_ = false;
+
+  base::WeakPtrFactory<BrowserPool> weak_factory_;
+
+  DISALLOW_COPY_AND_ASSIGN(BrowserPool);
+};
+
+}  // namespace nu
+
+#endif  // NATIVEUI_BROWSER_POOL_H_
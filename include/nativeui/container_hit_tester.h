@@ -0,0 +1,107 @@
+// Copyright 2018 Cheng Zhao. All rights reserved.
+// Use of this source code is governed by the license that can be found in the
+// LICENSE file.
+
+#ifndef NATIVEUI_CONTAINER_HIT_TESTER_H_
+#define NATIVEUI_CONTAINER_HIT_TESTER_H_
+
+#include <vector>
+
+#include "nativeui/container.h"
+#include "nativeui/events/event.h"
+#include "nativeui/gfx/spatial_index.h"
+
+namespace nu {
+
+// Find which of the items drawn in a container's on_draw is under the mouse.
+//
+// Items are registered with their bounds in the container's coordinates,
+// typically while drawing:
+//
+//   container->on_draw.Connect([&](Container*, Painter* painter,
+//                                  const RectF&) {
+//     hit_tester.ClearItems();
+//     for (const Obstacle& o : obstacles) {
+//       painter->FillRect(o.bounds);
+//       hit_tester.AddItem(o.id, o.bounds);
+//     }
+//     hit_tester.BuildItems();
+//   });
+//
+// Lookups go through a SpatialIndex, so they stay cheap with many items. The
+// hovered item is tracked from the container's mouse events, and
+// on_hover_item is emitted when it changes, e.g. to show a tooltip.
+class ContainerHitTester {
+ public:
+  static constexpr int kNoItem = SpatialIndex::kNoItem;
+
+  explicit ContainerHitTester(Container* container) : container_(container) {
+    on_move_id_ = container_->on_mouse_move.Connect(
+        [this](View*, const MouseEvent& event) {
+          has_mouse_ = true;
+          mouse_position_ = event.position_in_view;
+          SetHoveredItem(ItemAt(mouse_position_));
+        });
+    on_leave_id_ = container_->on_mouse_leave.Connect(
+        [this](View*, const MouseEvent&) {
+          has_mouse_ = false;
+          SetHoveredItem(kNoItem);
+        });
+  }
+
+  ~ContainerHitTester() {
+    container_->on_mouse_move.Disconnect(on_move_id_);
+    container_->on_mouse_leave.Disconnect(on_leave_id_);
+  }
+
+  // Replace the items: clear, add each of them, then build the index.
+  void ClearItems() { index_.Clear(); }
+  void AddItem(int id, const RectF& bounds) { index_.Add(id, bounds); }
+  void BuildItems() {
+    index_.Build();
+    // The item under a still mouse may have moved.
+    if (has_mouse_)
+      SetHoveredItem(ItemAt(mouse_position_));
+  }
+
+  // Return the top item at |point|, or kNoItem.
+  int ItemAt(const PointF& point) const { return index_.HitTest(point); }
+
+  int ItemAt(const MouseEvent& event) const {
+    return ItemAt(event.position_in_view);
+  }
+
+  // Append all the items at |point|, bottom first.
+  void ItemsAt(const PointF& point, std::vector<int>* ids) const {
+    index_.QueryPoint(point, ids);
+  }
+
+  int GetHoveredItem() const { return hovered_item_; }
+
+  // Events.
+  Signal<void(Container*, int)> on_hover_item;
+
+ private:
+  void SetHoveredItem(int id) {
+    if (id == hovered_item_)
+      return;
+    hovered_item_ = id;
+    on_hover_item.Emit(container_.get(), id);
+  }
+
+  scoped_refptr<Container> container_;
+  SpatialIndex index_;
+
+  bool has_mouse_ = false;
+  PointF mouse_position_;
+  int hovered_item_ = kNoItem;
+
+  int on_move_id_;
+  int on_leave_id_;
+
+  DISALLOW_COPY_AND_ASSIGN(ContainerHitTester);
+};
+
+}  // namespace nu
+
+#endif  // NATIVEUI_CONTAINER_HIT_TESTER_H_
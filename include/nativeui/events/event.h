@@ -5,6 +5,8 @@
 #ifndef NATIVEUI_EVENTS_EVENT_H_
 #define NATIVEUI_EVENTS_EVENT_H_
 
+#include <vector>
+
 #include "nativeui/events/keyboard_codes.h"
 #include "nativeui/gfx/geometry/point_f.h"
 #include "nativeui/types.h"
@@ -50,8 +52,36 @@ struct NATIVEUI_EXPORT MouseEvent : public Event {
   int button;
   PointF position_in_view;
   PointF position_in_window;
+
+  // When this mouse move event is emitted by a MouseMoveCoalescer, return
+  // the events it merged, oldest first and ending with this one; otherwise
+  // return an empty list.
+  inline const std::vector<MouseEvent>& GetCoalescedEvents() const;
+};
+
+namespace internal {
+
+// The event being emitted by a MouseMoveCoalescer and the events merged into
+// it. Kept outside MouseEvent to not change its layout.
+struct CoalescedMouseEvents {
+  const MouseEvent* event = nullptr;
+  const std::vector<MouseEvent>* events = nullptr;
+
+  static CoalescedMouseEvents* Get() {
+    static CoalescedMouseEvents current;
+    return &current;
+  }
 };
 
+}  // namespace internal
+
+const std::vector<MouseEvent>& MouseEvent::GetCoalescedEvents() const {
+  static const std::vector<MouseEvent> empty;
+  internal::CoalescedMouseEvents* current =
+      internal::CoalescedMouseEvents::Get();
+  return current->event == this ? *current->events : empty;
+}
+
 // Key events.
 struct NATIVEUI_EXPORT KeyEvent: public Event {
   // Create from the native event.
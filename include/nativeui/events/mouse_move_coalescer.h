@@ -0,0 +1,129 @@
+// Copyright 2018 Cheng Zhao. All rights reserved.
+// Use of this source code is governed by the license that can be found in the
+// LICENSE file.
+
+#ifndef NATIVEUI_EVENTS_MOUSE_MOVE_COALESCER_H_
+#define NATIVEUI_EVENTS_MOUSE_MOVE_COALESCER_H_
+
+#include <utility>
+#include <vector>
+
+#include "base/memory/weak_ptr.h"
+#include "base/time/time.h"
+#include "nativeui/events/event.h"
+#include "nativeui/message_loop.h"
+#include "nativeui/view.h"
+
+namespace nu {
+
+// Deliver the mouse moves of a view at most once per frame.
+//
+// View::on_mouse_move fires for every native motion event, which is up to
+// 1000 times per second with high polling rate mice. Views that opt in by
+// creating a coalescer connect to its on_mouse_move instead, which only
+// emits the latest position of each frame. The positions in between are
+// available from MouseEvent::GetCoalescedEvents(), e.g. for drawing tools.
+//
+// Pending moves are emitted before the view's mouse down, up and leave
+// events, as long as the coalescer was created before their other handlers
+// were connected.
+//
+// Must be used on the GUI thread.
+class MouseMoveCoalescer {
+ public:
+  static constexpr int kFrameIntervalMs = 16;
+
+  explicit MouseMoveCoalescer(View* view, int interval_ms = kFrameIntervalMs)
+      : view_(view), interval_ms_(interval_ms), weak_factory_(this) {
+    on_move_id_ = view_->on_mouse_move.Connect(
+        [this](View*, const MouseEvent& event) { OnMouseMove(event); });
+    on_down_id_ = view_->on_mouse_down.Connect(
+        [this](View*, const MouseEvent&) { Flush(); return false; });
+    on_up_id_ = view_->on_mouse_up.Connect(
+        [this](View*, const MouseEvent&) { Flush(); return false; });
+    on_leave_id_ = view_->on_mouse_leave.Connect(
+        [this](View*, const MouseEvent&) { Flush(); });
+  }
+
+  ~MouseMoveCoalescer() {
+    view_->on_mouse_move.Disconnect(on_move_id_);
+    view_->on_mouse_down.Disconnect(on_down_id_);
+    view_->on_mouse_up.Disconnect(on_up_id_);
+    view_->on_mouse_leave.Disconnect(on_leave_id_);
+  }
+
+  // Emit the pending moves now.
+  void Flush() {
+    scheduled_.Cancel();
+    if (pending_.empty())
+      return;
+    last_emit_ = base::TimeTicks::Now();
+    std::vector<MouseEvent> events;
+    events.swap(pending_);
+    internal::CoalescedMouseEvents* current =
+        internal::CoalescedMouseEvents::Get();
+    internal::CoalescedMouseEvents saved = *current;
+    current->event = &events.back();
+    current->events = &events;
+    on_mouse_move.Emit(view_.get(), events.back());
+    *current = saved;
+  }
+
+  // Number of moves waiting for the next frame.
+  size_t pending_count() const { return pending_.size(); }
+
+  // Events.
+  Signal<void(View*, const MouseEvent&)> on_mouse_move;
+
+ private:
+  void OnMouseMove(const MouseEvent& event) {
+    pending_.push_back(event);
+    // The native event is only valid while it is being dispatched.
+    pending_.back().native_event = nullptr;
+    if (scheduled_.IsPending() || posted_)
+      return;
+    // Emit right after the current batch of native events when a frame has
+    // passed since the last emission, otherwise at the next frame.
+    base::TimeDelta interval = base::TimeDelta::FromMilliseconds(interval_ms_);
+    base::TimeDelta elapsed = base::TimeTicks::Now() - last_emit_;
+    if (last_emit_.is_null() || elapsed >= interval) {
+      posted_ = true;
+      MessageLoop::PostTask(
+          MessageLoop::TaskPriority::kHigh,
+          base::BindOnce(&MouseMoveCoalescer::OnPostedFlush,
+                         weak_factory_.GetWeakPtr()));
+    } else {
+      // Less than |interval_ms_|, so it fits an int.
+      int wait = static_cast<int>((interval - elapsed).InMilliseconds());
+      scheduled_ = MessageLoop::PostDelayedTask(
+          wait, base::BindOnce(&MouseMoveCoalescer::Flush,
+                               weak_factory_.GetWeakPtr()));
+    }
+  }
+
+  void OnPostedFlush() {
+    posted_ = false;
+    Flush();
+  }
+
+  scoped_refptr<View> view_;
+  const int interval_ms_;
+
+  std::vector<MouseEvent> pending_;
+  base::TimeTicks last_emit_;
+  MessageLoop::DelayedTaskHandle scheduled_;
+  bool posted_ = false;
+
+  int on_move_id_;
+  int on_down_id_;
+  int on_up_id_;
+  int on_leave_id_;
+
+  base::WeakPtrFactory<MouseMoveCoalescer> weak_factory_;
+
+  DISALLOW_COPY_AND_ASSIGN(MouseMoveCoalescer);
+};
+
+}  // namespace nu
+
+#endif  // NATIVEUI_EVENTS_MOUSE_MOVE_COALESCER_H_
@@ -0,0 +1,222 @@
+// Copyright 2018 Cheng Zhao. All rights reserved.
+// Use of this source code is governed by the license that can be found in the
+// LICENSE file.
+
+#ifndef NATIVEUI_GFX_SPATIAL_INDEX_H_
+#define NATIVEUI_GFX_SPATIAL_INDEX_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <algorithm>
+#include <limits>
+#include <utility>
+#include <vector>
+
+#include "base/macros.h"
+#include "nativeui/gfx/geometry/point_f.h"
+#include "nativeui/gfx/geometry/rect_f.h"
+
+namespace nu {
+
+// A static R-tree of rectangles, for finding the custom-drawn items under a
+// point.
+//
+// Items are added and then indexed at once with Build(), which is meant to
+// be done again whenever the items change, e.g. once per frame. Build()
+// sorts the items along a Hilbert curve and packs them into nodes of
+// kNodeSize entries, so queries visit O(log n) nodes for typical layouts.
+//
+// Items are identified by the ids passed to Add(). When items overlap, the
+// one added last is considered to be on top, as it would be drawn last.
+class SpatialIndex {
+ public:
+  static constexpr int kNodeSize = 16;
+  static constexpr int kNoItem = -1;
+
+  SpatialIndex() = default;
+
+  // Remove all items. The index is empty until Build().
+  void Clear() {
+    items_.clear();
+    boxes_.clear();
+    entries_.clear();
+    level_ends_.clear();
+  }
+
+  void Reserve(size_t count) { items_.reserve(count); }
+
+  // Add an item; it is found by queries after the next Build().
+  void Add(int id, const RectF& bounds) {
+    items_.push_back({id, Box::FromRect(bounds)});
+  }
+
+  void Build() {
+    boxes_.clear();
+    entries_.clear();
+    level_ends_.clear();
+    size_t count = items_.size();
+    if (count == 0)
+      return;
+
+    Box extent = items_[0].box;
+    for (const Item& item : items_)
+      extent.Union(item.box);
+
+    // Order the items along the Hilbert curve of their centers.
+    std::vector<std::pair<uint32_t, uint32_t>> order(count);
+    float width = std::max(extent.max_x - extent.min_x,
+                           std::numeric_limits<float>::min());
+    float height = std::max(extent.max_y - extent.min_y,
+                            std::numeric_limits<float>::min());
+    for (size_t i = 0; i < count; ++i) {
+      const Box& box = items_[i].box;
+      auto x = static_cast<uint32_t>(
+          kHilbertMax * ((box.min_x + box.max_x) / 2 - extent.min_x) / width);
+      auto y = static_cast<uint32_t>(
+          kHilbertMax * ((box.min_y + box.max_y) / 2 - extent.min_y) / height);
+      order[i] = {HilbertIndex(x, y), static_cast<uint32_t>(i)};
+    }
+    std::sort(order.begin(), order.end());
+
+    // The leaves, then each level of nodes up to the root.
+    boxes_.reserve(count + count / (kNodeSize - 1) + 1);
+    entries_.reserve(boxes_.capacity());
+    for (const auto& it : order) {
+      boxes_.push_back(items_[it.second].box);
+      entries_.push_back(it.second);
+    }
+    level_ends_.push_back(count);
+    size_t begin = 0;
+    while (level_ends_.back() - begin > 1) {
+      size_t end = level_ends_.back();
+      for (size_t i = begin; i < end; i += kNodeSize) {
+        Box box = boxes_[i];
+        for (size_t j = i + 1; j < std::min(i + kNodeSize, end); ++j)
+          box.Union(boxes_[j]);
+        boxes_.push_back(box);
+        entries_.push_back(static_cast<uint32_t>(i));
+      }
+      begin = end;
+      level_ends_.push_back(boxes_.size());
+    }
+  }
+
+  // Return the id of the top item containing |point|, or kNoItem.
+  int HitTest(const PointF& point) const {
+    int top = -1;
+    Search(Box{point.x(), point.y(), point.x(), point.y()},
+           [&top](uint32_t index) {
+             top = std::max(top, static_cast<int>(index));
+           });
+    return top < 0 ? kNoItem : items_[top].id;
+  }
+
+  // Append the ids of the items containing |point|, bottom first.
+  void QueryPoint(const PointF& point, std::vector<int>* ids) const {
+    Query(Box{point.x(), point.y(), point.x(), point.y()}, ids);
+  }
+
+  // Append the ids of the items intersecting |rect|, bottom first.
+  void QueryRect(const RectF& rect, std::vector<int>* ids) const {
+    Query(Box::FromRect(rect), ids);
+  }
+
+  // Number of items added, and whether they have been indexed.
+  size_t size() const { return items_.size(); }
+  bool is_built() const { return !level_ends_.empty(); }
+
+ private:
+  // Max coordinate on the 16 bits grid of the Hilbert curve.
+  static constexpr float kHilbertMax = 65535.f;
+
+  // Edges are inclusive, so a point on the border of an item hits it.
+  struct Box {
+    float min_x, min_y, max_x, max_y;
+
+    static Box FromRect(const RectF& rect) {
+      return Box{rect.x(), rect.y(), rect.right(), rect.bottom()};
+    }
+
+    bool Intersects(const Box& other) const {
+      return min_x <= other.max_x && other.min_x <= max_x &&
+             min_y <= other.max_y && other.min_y <= max_y;
+    }
+
+    void Union(const Box& other) {
+      min_x = std::min(min_x, other.min_x);
+      min_y = std::min(min_y, other.min_y);
+      max_x = std::max(max_x, other.max_x);
+      max_y = std::max(max_y, other.max_y);
+    }
+  };
+
+  struct Item {
+    int id;
+    Box box;
+  };
+
+  // Call |visit| with the index in |items_| of each item intersecting
+  // |query|.
+  template<typename Visitor>
+  void Search(const Box& query, const Visitor& visit) const {
+    if (level_ends_.empty())
+      return;
+    // Stack of (node position, level).
+    std::vector<std::pair<size_t, size_t>> stack;
+    stack.emplace_back(boxes_.size() - 1, level_ends_.size() - 1);
+    while (!stack.empty()) {
+      size_t pos = stack.back().first;
+      size_t level = stack.back().second;
+      stack.pop_back();
+      if (!boxes_[pos].Intersects(query))
+        continue;
+      if (level == 0) {
+        visit(entries_[pos]);
+        continue;
+      }
+      size_t begin = entries_[pos];
+      size_t end = std::min(begin + kNodeSize, level_ends_[level - 1]);
+      for (size_t child = begin; child < end; ++child)
+        stack.emplace_back(child, level - 1);
+    }
+  }
+
+  void Query(const Box& query, std::vector<int>* ids) const {
+    std::vector<uint32_t> found;
+    Search(query, [&found](uint32_t index) { found.push_back(index); });
+    std::sort(found.begin(), found.end());
+    for (uint32_t index : found)
+      ids->push_back(items_[index].id);
+  }
+
+  // Position of (x, y) along the Hilbert curve filling the 16 bits grid.
+  static uint32_t HilbertIndex(uint32_t x, uint32_t y) {
+    uint32_t index = 0;
+    for (uint32_t s = 1u << 15; s > 0; s >>= 1) {
+      uint32_t rx = (x & s) > 0;
+      uint32_t ry = (y & s) > 0;
+      index += s * s * ((3 * rx) ^ ry);
+      // Rotate the quadrant.
+      if (ry == 0) {
+        if (rx == 1) {
+          x = 0xFFFF - x;
+          y = 0xFFFF - y;
+        }
+        std::swap(x, y);
+      }
+    }
+    return index;
+  }
+
+  std::vector<Item> items_;        // In the order they were added.
+  std::vector<Box> boxes_;         // Leaves, then nodes level by level.
+  std::vector<uint32_t> entries_;  // Item index, or first child.
+  std::vector<size_t> level_ends_;
+
+  DISALLOW_COPY_AND_ASSIGN(SpatialIndex);
+};
+
+}  // namespace nu
+
+#endif  // NATIVEUI_GFX_SPATIAL_INDEX_H_
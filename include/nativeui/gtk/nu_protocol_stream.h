@@ -7,6 +7,8 @@
 
 #include <gio/gio.h>
 
+#include "base/memory/ref_counted_memory.h"
+
 // Custom GIO input stream for wrapping ProtocolJob.
 
 namespace nu {
@@ -40,6 +42,25 @@ struct _NUProtocolStreamClass {
 GType nu_protocol_stream_get_type();
 GInputStream* nu_protocol_stream_new(ProtocolJob*);
 
+// Create a stream reading straight from |buffer|, e.g. the GetDirectBuffer()
+// of a mapped job, instead of copying it through ProtocolJob::Read(). The
+// buffer is released when WebKit drops the stream. Used by
+// ProtocolSchemeRequest::FinishWithDirectBuffer().
+inline GInputStream* nu_protocol_stream_new_for_buffer(
+    scoped_refptr<base::RefCountedMemory> buffer) {
+  base::RefCountedMemory* memory = buffer.get();
+  memory->AddRef();
+  GBytes* bytes = g_bytes_new_with_free_func(
+      memory->front(), memory->size(),
+      [](gpointer data) {
+        static_cast<base::RefCountedMemory*>(data)->Release();
+      },
+      memory);
+  GInputStream* stream = g_memory_input_stream_new_from_bytes(bytes);
+  g_bytes_unref(bytes);
+  return stream;
+}
+
 }  // namespace nu
 
 #endif  // NATIVEUI_GTK_NU_PROTOCOL_STREAM_H_
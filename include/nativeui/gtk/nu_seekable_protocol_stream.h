@@ -0,0 +1,183 @@
+// Copyright 2018 Cheng Zhao. All rights reserved.
+// Use of this source code is governed by the license that can be found in the
+// LICENSE file.
+
+#ifndef NATIVEUI_GTK_NU_SEEKABLE_PROTOCOL_STREAM_H_
+#define NATIVEUI_GTK_NU_SEEKABLE_PROTOCOL_STREAM_H_
+
+#include <gio/gio.h>
+
+#include <algorithm>
+
+#include "nativeui/protocol_seekable_file_job.h"
+
+// GIO input stream wrapping a ProtocolSeekableFileJob, which implements
+// GSeekable by seeking the job, so seeking does not read the content in
+// between.
+
+namespace nu {
+
+#define NU_TYPE_SEEKABLE_PROTOCOL_STREAM (nu_seekable_protocol_stream_get_type())
+#define NU_SEEKABLE_PROTOCOL_STREAM(o)   (G_TYPE_CHECK_INSTANCE_CAST((o), \
+                                          NU_TYPE_SEEKABLE_PROTOCOL_STREAM, \
+                                          NUSeekableProtocolStream))
+
+typedef struct _NUSeekableProtocolStream      NUSeekableProtocolStream;
+typedef struct _NUSeekableProtocolStreamClass NUSeekableProtocolStreamClass;
+
+struct _NUSeekableProtocolStream {
+  GInputStream parent_instance;
+  ProtocolSeekableFileJob* job;
+  goffset position;
+};
+
+struct _NUSeekableProtocolStreamClass {
+  GInputStreamClass parent_class;
+};
+
+namespace internal {
+
+inline GObjectClass*& SeekableProtocolStreamParentClass() {
+  static GObjectClass* parent_class = nullptr;
+  return parent_class;
+}
+
+inline void SeekableProtocolStreamFinalize(GObject* object) {
+  NU_SEEKABLE_PROTOCOL_STREAM(object)->job->Release();
+  SeekableProtocolStreamParentClass()->finalize(object);
+}
+
+inline gssize SeekableProtocolStreamRead(GInputStream* stream,
+                                         void* buffer,
+                                         gsize count,
+                                         GCancellable*,
+                                         GError**) {
+  NUSeekableProtocolStream* self = NU_SEEKABLE_PROTOCOL_STREAM(stream);
+  size_t size = self->job->Read(buffer, count);
+  self->position += size;
+  return size;
+}
+
+inline gboolean SeekableProtocolStreamSeekTo(NUSeekableProtocolStream* self,
+                                             goffset offset,
+                                             GError** error) {
+  if (offset < 0 ||
+      static_cast<uint64_t>(offset) > self->job->content_length() ||
+      !self->job->Seek(offset)) {
+    g_set_error_literal(error, G_IO_ERROR, G_IO_ERROR_INVALID_ARGUMENT,
+                        "Invalid seek request");
+    return FALSE;
+  }
+  self->position = offset;
+  return TRUE;
+}
+
+inline gssize SeekableProtocolStreamSkip(GInputStream* stream,
+                                         gsize count,
+                                         GCancellable*,
+                                         GError** error) {
+  NUSeekableProtocolStream* self = NU_SEEKABLE_PROTOCOL_STREAM(stream);
+  goffset left = self->job->content_length() - self->position;
+  goffset skip = std::min<goffset>(count, left);
+  if (!SeekableProtocolStreamSeekTo(self, self->position + skip, error))
+    return -1;
+  return skip;
+}
+
+inline gboolean SeekableProtocolStreamClose(GInputStream* stream,
+                                            GCancellable*,
+                                            GError**) {
+  NU_SEEKABLE_PROTOCOL_STREAM(stream)->job->Kill();
+  return TRUE;
+}
+
+inline goffset SeekableProtocolStreamTell(GSeekable* seekable) {
+  return NU_SEEKABLE_PROTOCOL_STREAM(seekable)->position;
+}
+
+inline gboolean SeekableProtocolStreamCanSeek(GSeekable*) {
+  return TRUE;
+}
+
+inline gboolean SeekableProtocolStreamSeek(GSeekable* seekable,
+                                           goffset offset,
+                                           GSeekType type,
+                                           GCancellable*,
+                                           GError** error) {
+  NUSeekableProtocolStream* self = NU_SEEKABLE_PROTOCOL_STREAM(seekable);
+  if (type == G_SEEK_CUR)
+    offset += self->position;
+  else if (type == G_SEEK_END)
+    offset += self->job->content_length();
+  return SeekableProtocolStreamSeekTo(self, offset, error);
+}
+
+inline gboolean SeekableProtocolStreamCanTruncate(GSeekable*) {
+  return FALSE;
+}
+
+inline gboolean SeekableProtocolStreamTruncate(GSeekable*,
+                                               goffset,
+                                               GCancellable*,
+                                               GError** error) {
+  g_set_error_literal(error, G_IO_ERROR, G_IO_ERROR_NOT_SUPPORTED,
+                      "Cannot truncate a protocol stream");
+  return FALSE;
+}
+
+inline void SeekableProtocolStreamClassInit(gpointer klass, gpointer) {
+  SeekableProtocolStreamParentClass() =
+      G_OBJECT_CLASS(g_type_class_peek_parent(klass));
+  G_OBJECT_CLASS(klass)->finalize = SeekableProtocolStreamFinalize;
+  GInputStreamClass* stream_class = G_INPUT_STREAM_CLASS(klass);
+  stream_class->read_fn = SeekableProtocolStreamRead;
+  stream_class->skip = SeekableProtocolStreamSkip;
+  stream_class->close_fn = SeekableProtocolStreamClose;
+}
+
+inline void SeekableProtocolStreamSeekableInit(gpointer g_iface, gpointer) {
+  GSeekableIface* iface = static_cast<GSeekableIface*>(g_iface);
+  iface->tell = SeekableProtocolStreamTell;
+  iface->can_seek = SeekableProtocolStreamCanSeek;
+  iface->seek = SeekableProtocolStreamSeek;
+  iface->can_truncate = SeekableProtocolStreamCanTruncate;
+  iface->truncate_fn = SeekableProtocolStreamTruncate;
+}
+
+}  // namespace internal
+
+// Registered on first use; the function is inline, so the type is registered
+// once however many files include this header.
+inline GType nu_seekable_protocol_stream_get_type() {
+  static GType type = [] {
+    GTypeInfo info = {};
+    info.class_size = sizeof(NUSeekableProtocolStreamClass);
+    info.class_init = internal::SeekableProtocolStreamClassInit;
+    info.instance_size = sizeof(NUSeekableProtocolStream);
+    GType type = g_type_register_static(
+        G_TYPE_INPUT_STREAM, "NUSeekableProtocolStream", &info,
+        static_cast<GTypeFlags>(0));
+    GInterfaceInfo seekable_info = {};
+    seekable_info.interface_init = internal::SeekableProtocolStreamSeekableInit;
+    g_type_add_interface_static(type, G_TYPE_SEEKABLE, &seekable_info);
+    return type;
+  }();
+  return type;
+}
+
+// Create a stream reading |job|, which must have been started. The stream
+// keeps a reference to the job. Used by
+// ProtocolSchemeRequest::FinishWithRange() for whole responses.
+inline GInputStream* nu_seekable_protocol_stream_new(
+    ProtocolSeekableFileJob* job) {
+  NUSeekableProtocolStream* stream = NU_SEEKABLE_PROTOCOL_STREAM(
+      g_object_new(NU_TYPE_SEEKABLE_PROTOCOL_STREAM, nullptr));
+  job->AddRef();
+  stream->job = job;
+  stream->position = 0;
+  return G_INPUT_STREAM(stream);
+}
+
+}  // namespace nu
+
+#endif  // NATIVEUI_GTK_NU_SEEKABLE_PROTOCOL_STREAM_H_
@@ -0,0 +1,263 @@
+// Copyright 2018 Cheng Zhao. All rights reserved.
+// Use of this source code is governed by the license that can be found in the
+// LICENSE file.
+
+#ifndef NATIVEUI_GTK_PROTOCOL_SCHEME_HANDLER_H_
+#define NATIVEUI_GTK_PROTOCOL_SCHEME_HANDLER_H_
+
+#include <webkit2/webkit2.h>
+
+#include <functional>
+#include <memory>
+#include <string>
+#include <utility>
+
+#include "base/logging.h"
+#include "nativeui/gtk/nu_protocol_stream.h"
+#include "nativeui/gtk/nu_seekable_protocol_stream.h"
+#include "nativeui/protocol_job.h"
+#include "nativeui/protocol_range_job.h"
+
+// Serve a custom scheme through WebKit's URI scheme API directly, for the
+// responses Browser::RegisterProtocol() can not give: a job's memory handed
+// to WebKit without copying, and parts of a file for Range requests.
+
+namespace nu {
+
+namespace internal {
+
+// A request waiting for its job to report the content length.
+struct PendingSchemeResponse {
+  PendingSchemeResponse(WebKitURISchemeRequest* request,
+                        scoped_refptr<ProtocolJob> job)
+      : request(WEBKIT_URI_SCHEME_REQUEST(g_object_ref(request))),
+        job(std::move(job)),
+        stream(nu_protocol_stream_new(this->job.get())) {}
+
+  ~PendingSchemeResponse() { Reset(); }
+
+  void Reset() {
+    if (request)
+      g_object_unref(request);
+    if (stream)
+      g_object_unref(stream);
+    request = nullptr;
+    job = nullptr;
+    stream = nullptr;
+  }
+
+  WebKitURISchemeRequest* request;
+  scoped_refptr<ProtocolJob> job;
+  GInputStream* stream;
+};
+
+}  // namespace internal
+
+// A request of a scheme registered with RegisterProtocolSchemeHandler(). The
+// handler answers it by calling one of the Finish methods before returning,
+// otherwise the request fails.
+class ProtocolSchemeRequest {
+ public:
+  explicit ProtocolSchemeRequest(WebKitURISchemeRequest* request)
+      : request_(request) {}
+
+  ~ProtocolSchemeRequest() {
+    if (!finished_)
+      FinishWithError("Unhandled request");
+  }
+
+  std::string GetURL() const {
+    return webkit_uri_scheme_request_get_uri(request_);
+  }
+
+  // Get the request header |name|. WebKitGTK only exposes the headers since
+  // 2.36; this always fails with older versions.
+  bool GetHeader(const char* name, std::string* value) const {
+#if WEBKIT_CHECK_VERSION(2, 36, 0)
+    SoupMessageHeaders* headers =
+        webkit_uri_scheme_request_get_http_headers(request_);
+    const char* header =
+        headers ? soup_message_headers_get_one(headers, name) : nullptr;
+    if (header) {
+      *value = header;
+      return true;
+    }
+#endif
+    return false;
+  }
+
+  // Serve |job| through ProtocolJob::Read(), as Browser::RegisterProtocol()
+  // does. The job may report its content length after Start() returned, e.g.
+  // ProtocolAsyncJob, and the response is sent then.
+  void Finish(scoped_refptr<ProtocolJob> job) {
+    SetFinished();
+    auto pending =
+        std::make_shared<internal::PendingSchemeResponse>(request_, job);
+    // |pending| is reset once the response is sent, so the job does not keep
+    // itself alive through its callback.
+    job->Plug([pending](int length) {
+      if (!pending->job)
+        return;
+      std::string mime_type;
+      if (pending->job->GetMimeType(&mime_type))
+        webkit_uri_scheme_request_finish(pending->request, pending->stream,
+                                         length, mime_type.c_str());
+      else
+        FailRequest(pending->request, "Unknown mime type");
+      pending->Reset();
+    });
+    if (!job->Start() && pending->job) {
+      FailRequest(request_, "Failed to start protocol job");
+      pending->Reset();
+    }
+  }
+
+  // Serve a job offering GetDirectBuffer(): ProtocolMappedFileJob,
+  // ProtocolMappedAsarJob or ProtocolMemoryJob. WebKit reads the buffer
+  // itself, which for the mapped jobs is the page cache, instead of having it
+  // copied through Read(). Jobs without a buffer, e.g. encrypted asar
+  // entries, are served through Read().
+  template<typename Job>
+  void FinishWithDirectBuffer(scoped_refptr<Job> job) {
+    SetFinished();
+    job->Plug([](int) {});
+    std::string mime_type;
+    if (!job->Start() || !job->GetMimeType(&mime_type)) {
+      FailRequest(request_, "Failed to start protocol job");
+      return;
+    }
+    scoped_refptr<base::RefCountedMemory> buffer = job->GetDirectBuffer();
+    GInputStream* stream;
+    gint64 length = -1;
+    if (buffer) {
+      length = static_cast<gint64>(buffer->size());
+      stream = nu_protocol_stream_new_for_buffer(std::move(buffer));
+    } else {
+      stream = nu_protocol_stream_new(job.get());
+    }
+    webkit_uri_scheme_request_finish(request_, stream, length,
+                                     mime_type.c_str());
+    g_object_unref(stream);
+  }
+
+  // Serve a seekable job for the Range header of the request, with a
+  // ProtocolRangeJob: a 206 response with the part of the content asked for,
+  // a 416 response for a range past the end, or the whole content with 200,
+  // readable through a seekable stream. The response advertises
+  // "Accept-Ranges: bytes", so media elements request ranges when seeking.
+  //
+  // Statuses and response headers need WebKitGTK 2.36; with older versions
+  // the Range header can not be read and the whole content is served.
+  void FinishWithRange(scoped_refptr<ProtocolSeekableFileJob> job) {
+    SetFinished();
+    std::string range;
+    GetHeader("Range", &range);
+    scoped_refptr<ProtocolRangeJob> range_job(new ProtocolRangeJob(job, range));
+    range_job->Plug([](int) {});
+    bool started = range_job->Start();
+    int status = range_job->status_code();
+    if (status == 416) {
+      Respond(g_memory_input_stream_new(), 0, "text/plain", status,
+              range_job->content_range());
+      return;
+    }
+    std::string mime_type;
+    if (!started || !job->GetMimeType(&mime_type)) {
+      FailRequest(request_, "Failed to start protocol job");
+      return;
+    }
+    if (status == 206)
+      Respond(nu_protocol_stream_new(range_job.get()),
+              static_cast<gint64>(range_job->range_length()), mime_type,
+              status, range_job->content_range());
+    else
+      Respond(nu_seekable_protocol_stream_new(job.get()),
+              static_cast<gint64>(job->content_length()), mime_type, status,
+              std::string());
+  }
+
+  void FinishWithError(const char* message) {
+    SetFinished();
+    FailRequest(request_, message);
+  }
+
+ private:
+  // Send a response of a range request, taking |stream|.
+  void Respond(GInputStream* stream,
+               gint64 length,
+               const std::string& mime_type,
+               int status,
+               const std::string& content_range) {
+#if WEBKIT_CHECK_VERSION(2, 36, 0)
+    WebKitURISchemeResponse* response =
+        webkit_uri_scheme_response_new(stream, length);
+    webkit_uri_scheme_response_set_status(response, status, nullptr);
+    webkit_uri_scheme_response_set_content_type(response, mime_type.c_str());
+    SoupMessageHeaders* headers =
+        soup_message_headers_new(SOUP_MESSAGE_HEADERS_RESPONSE);
+    soup_message_headers_append(headers, "Accept-Ranges", "bytes");
+    if (!content_range.empty())
+      soup_message_headers_append(headers, "Content-Range",
+                                  content_range.c_str());
+    // Takes the headers.
+    webkit_uri_scheme_response_set_http_headers(response, headers);
+    webkit_uri_scheme_request_finish_with_response(request_, response);
+    g_object_unref(response);
+#else
+    DCHECK_EQ(status, 200);
+    webkit_uri_scheme_request_finish(request_, stream, length,
+                                     mime_type.c_str());
+#endif
+    g_object_unref(stream);
+  }
+
+  static void FailRequest(WebKitURISchemeRequest* request,
+                          const char* message) {
+    GError* error = g_error_new_literal(G_IO_ERROR, G_IO_ERROR_FAILED,
+                                        message);
+    webkit_uri_scheme_request_finish_error(request, error);
+    g_error_free(error);
+  }
+
+  void SetFinished() {
+    DCHECK(!finished_) << "The request can only be finished once";
+    finished_ = true;
+  }
+
+  WebKitURISchemeRequest* request_;
+  bool finished_ = false;
+
+  DISALLOW_COPY_AND_ASSIGN(ProtocolSchemeRequest);
+};
+
+using ProtocolSchemeHandler = std::function<void(ProtocolSchemeRequest*)>;
+
+namespace internal {
+
+inline void OnProtocolSchemeRequest(WebKitURISchemeRequest* request,
+                                    gpointer data) {
+  ProtocolSchemeRequest scheme_request(request);
+  (*static_cast<ProtocolSchemeHandler*>(data))(&scheme_request);
+}
+
+}  // namespace internal
+
+// Serve |scheme| for the browsers of the default WebKitWebContext. A scheme
+// is registered either here or with Browser::RegisterProtocol(), not both.
+//
+//   RegisterProtocolSchemeHandler("app", [](ProtocolSchemeRequest* request) {
+//     request->FinishWithDirectBuffer(base::MakeRefCounted<
+//         ProtocolMappedFileJob>(GetFilePath(request->GetURL())));
+//   });
+inline void RegisterProtocolSchemeHandler(const std::string& scheme,
+                                          ProtocolSchemeHandler handler) {
+  webkit_web_context_register_uri_scheme(
+      webkit_web_context_get_default(), scheme.c_str(),
+      internal::OnProtocolSchemeRequest,
+      new ProtocolSchemeHandler(std::move(handler)),
+      [](gpointer data) { delete static_cast<ProtocolSchemeHandler*>(data); });
+}
+
+}  // namespace nu
+
+#endif  // NATIVEUI_GTK_PROTOCOL_SCHEME_HANDLER_H_
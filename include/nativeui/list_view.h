@@ -0,0 +1,346 @@
+// Copyright 2018 Cheng Zhao. All rights reserved.
+// Use of this source code is governed by the license that can be found in the
+// LICENSE file.
+
+#ifndef NATIVEUI_LIST_VIEW_H_
+#define NATIVEUI_LIST_VIEW_H_
+
+#include <algorithm>
+#include <functional>
+#include <map>
+#include <utility>
+#include <vector>
+
+#include "base/logging.h"
+#include "nativeui/container.h"
+#include "nativeui/scroll.h"
+#include "nativeui/util/row_heights.h"
+
+#if defined(OS_LINUX)
+#include <gtk/gtk.h>
+#endif
+
+namespace nu {
+
+// A vertical list showing a large number of rows with only as many views as
+// fit in its viewport.
+//
+// The list is a Scroll whose content is sized for all the rows, but only the
+// rows in the viewport, plus |overscan| rows on each side, have views. Views
+// of rows scrolled out are hidden and bound to the rows scrolled in, so the
+// data source is asked for visible rows only.
+//
+// Rows have the height passed to the constructor, unless |measure_row| is
+// set: the height is then an estimate, replaced by the measured one when the
+// row first becomes visible. Inserting, removing or measuring rows above the
+// viewport keeps the rows in view where they are.
+//
+// On GTK the list follows the scrollbar of the Scroll. On other platforms
+// the host reports the viewport with SetViewport(), and scrolls to
+// GetScrollOffset() after the rows change.
+class ListView {
+ public:
+  struct DataSource {
+    // Create the view of a row. It is positioned absolutely by the list.
+    std::function<View*()> create_row;
+    // Show the content of row |index| in |view|.
+    std::function<void(View* view, int index)> bind_row;
+    // Return the height of row |index|; only for variable heights.
+    std::function<float(int index)> measure_row;
+  };
+
+  ListView(const DataSource& source, float row_height, int overscan = 4)
+      : source_(source),
+        row_height_(row_height),
+        overscan_(overscan),
+        scroll_(new Scroll),
+        content_(new Container) {
+    DCHECK(source_.create_row && source_.bind_row);
+    scroll_->SetScrollbarPolicy(Scroll::Policy::Never,
+                                Scroll::Policy::Automatic);
+    scroll_->SetContentView(content_.get());
+    on_size_changed_id_ = scroll_->on_size_changed.Connect(
+        [this](View*) { OnSizeChanged(); });
+    PlatformInit();
+  }
+
+  ~ListView() {
+    scroll_->on_size_changed.Disconnect(on_size_changed_id_);
+    PlatformDestroy();
+  }
+
+  // The view to add to the layout.
+  Scroll* GetView() const { return scroll_.get(); }
+
+  int GetRowCount() const { return heights_.count(); }
+
+  // Replace all the rows.
+  void SetRowCount(int count) {
+    for (auto& it : rows_)
+      Recycle(it.second.get());
+    rows_.clear();
+    heights_.Reset(count, row_height_);
+    measured_.assign(count, false);
+    offset_ = 0;
+    ApplyScrollOffset();
+    Update();
+  }
+
+  void InsertRows(int index, int count) {
+    DCHECK(index >= 0 && index <= GetRowCount() && count >= 0);
+    if (count == 0)
+      return;
+    // Follow the end of the list when appending while scrolled to the end,
+    // e.g. for logs.
+    bool follow = index == GetRowCount() &&
+                  offset_ + viewport_height_ >= heights_.Total() - 1;
+    bool above = heights_.Offset(index) < offset_;
+    heights_.Insert(index, count, row_height_);
+    measured_.insert(measured_.begin() + index, count, false);
+    ShiftRows(index, count);
+    if (above)
+      offset_ += static_cast<double>(count) * row_height_;
+    if (above || follow) {
+      if (follow)
+        offset_ = std::max(0.0, heights_.Total() - viewport_height_);
+      ApplyScrollOffset();
+    }
+    Update();
+  }
+
+  void RemoveRows(int index, int count) {
+    DCHECK(index >= 0 && count >= 0 && index + count <= GetRowCount());
+    if (count == 0)
+      return;
+    double top = heights_.Offset(index);
+    double above = std::min(heights_.Offset(index + count), offset_) - top;
+    for (auto it = rows_.lower_bound(index);
+         it != rows_.end() && it->first < index + count;) {
+      Recycle(it->second.get());
+      it = rows_.erase(it);
+    }
+    heights_.Erase(index, count);
+    measured_.erase(measured_.begin() + index,
+                    measured_.begin() + index + count);
+    ShiftRows(index + count, -count);
+    if (above > 0) {
+      offset_ -= above;
+      ApplyScrollOffset();
+    }
+    Update();
+  }
+
+  // Bind and measure rows again after their content changed.
+  void ReloadRows(int index, int count) {
+    DCHECK(index >= 0 && count >= 0 && index + count <= GetRowCount());
+    std::fill(measured_.begin() + index, measured_.begin() + index + count,
+              false);
+    for (auto it = rows_.lower_bound(index);
+         it != rows_.end() && it->first < index + count; ++it)
+      source_.bind_row(it->second.get(), it->first);
+    Update();
+  }
+
+  void ScrollToRow(int index) {
+    DCHECK(index >= 0 && index < GetRowCount());
+    offset_ = heights_.Offset(index);
+    ApplyScrollOffset();
+    Update();
+  }
+
+  // Internal: Called when the viewport of the Scroll changes.
+  void SetViewport(double offset, double height) {
+    offset_ = offset;
+    viewport_height_ = height;
+    Update();
+  }
+
+  double GetScrollOffset() const { return offset_; }
+
+  // Return the view showing row |index|, or null if it is not in view.
+  View* GetRowView(int index) const {
+    auto it = rows_.find(index);
+    return it == rows_.end() ? nullptr : it->second.get();
+  }
+
+ private:
+  // Rows in the viewport and the overscan.
+  void GetRange(int* first, int* last) const {
+    if (GetRowCount() == 0) {
+      *first = 0;
+      *last = -1;
+      return;
+    }
+    *first = std::max(0, heights_.IndexAt(offset_) - overscan_);
+    *last = std::min(GetRowCount() - 1,
+                     heights_.IndexAt(offset_ + viewport_height_) + overscan_);
+  }
+
+  void Update() {
+    if (updating_)
+      return;
+    updating_ = true;
+    int first, last;
+    GetRange(&first, &last);
+
+    if (source_.measure_row && first <= last) {
+      // Keep the row at the top of the viewport in place.
+      int anchor = heights_.IndexAt(offset_);
+      double anchor_delta = offset_ - heights_.Offset(anchor);
+      bool changed = false;
+      for (int i = first; i <= last; ++i) {
+        if (measured_[i])
+          continue;
+        measured_[i] = true;
+        float height = source_.measure_row(i);
+        if (height != heights_.Get(i)) {
+          heights_.Set(i, height);
+          changed = true;
+        }
+      }
+      if (changed) {
+        double offset = heights_.Offset(anchor) + anchor_delta;
+        if (offset != offset_) {
+          offset_ = offset;
+          ApplyScrollOffset();
+        }
+        // Rows that were not in range with the estimates are measured on the
+        // next change of the viewport.
+        GetRange(&first, &last);
+      }
+    }
+
+    scroll_->SetContentSize(SizeF(scroll_->GetBounds().width(),
+                                  static_cast<float>(heights_.Total())));
+
+    for (auto it = rows_.begin(); it != rows_.end();) {
+      if (it->first < first || it->first > last) {
+        Recycle(it->second.get());
+        it = rows_.erase(it);
+      } else {
+        ++it;
+      }
+    }
+    for (int i = first; i <= last; ++i) {
+      auto it = rows_.find(i);
+      View* view;
+      if (it == rows_.end()) {
+        view = Obtain();
+        source_.bind_row(view, i);
+        rows_.emplace(i, view);
+      } else {
+        view = it->second.get();
+      }
+      view->SetStyleProperty("top", static_cast<float>(heights_.Offset(i)));
+      view->SetStyleProperty("height", heights_.Get(i));
+      view->SetVisible(true);
+    }
+    content_->Layout();
+    updating_ = false;
+  }
+
+  // Return a hidden row view, or create one.
+  View* Obtain() {
+    if (!free_.empty()) {
+      View* view = free_.back().get();
+      free_.pop_back();
+      return view;
+    }
+    View* view = source_.create_row();
+    view->SetStyleProperty("position", "absolute");
+    view->SetStyleProperty("left", 0.f);
+    view->SetStyleProperty("right", 0.f);
+    content_->AddChildView(view);
+    return view;
+  }
+
+  void Recycle(View* view) {
+    view->SetVisible(false);
+    free_.emplace_back(view);
+  }
+
+  // Move the views of the rows from |index| by |delta| rows.
+  void ShiftRows(int index, int delta) {
+    std::map<int, scoped_refptr<View>> rows;
+    for (auto& it : rows_)
+      rows.emplace(it.first >= index ? it.first + delta : it.first,
+                   std::move(it.second));
+    rows_.swap(rows);
+  }
+
+#if defined(OS_LINUX)
+  GtkAdjustment* GetAdjustment() const {
+    return gtk_scrolled_window_get_vadjustment(
+        GTK_SCROLLED_WINDOW(scroll_->GetNative()));
+  }
+
+  static void OnAdjustmentChanged(GtkAdjustment* adjustment, ListView* self) {
+    if (self->updating_)
+      return;
+    self->SetViewport(gtk_adjustment_get_value(adjustment),
+                      gtk_adjustment_get_page_size(adjustment));
+  }
+
+  void OnSizeChanged() {
+    OnAdjustmentChanged(GetAdjustment(), this);
+  }
+
+  void PlatformInit() {
+    GtkAdjustment* adjustment = GetAdjustment();
+    g_signal_connect(adjustment, "value-changed",
+                     G_CALLBACK(OnAdjustmentChanged), this);
+    g_signal_connect(adjustment, "changed",
+                     G_CALLBACK(OnAdjustmentChanged), this);
+  }
+
+  void PlatformDestroy() {
+    g_signal_handlers_disconnect_by_data(GetAdjustment(), this);
+  }
+
+  // The adjustment only learns the new content size on the next allocation,
+  // so its upper bound is set too, or the offset would be clamped to the old
+  // size.
+  void ApplyScrollOffset() {
+    GtkAdjustment* adjustment = GetAdjustment();
+    bool updating = updating_;
+    updating_ = true;
+    gtk_adjustment_set_upper(adjustment, std::max(heights_.Total(),
+                                                  offset_ + viewport_height_));
+    gtk_adjustment_set_value(adjustment, offset_);
+    updating_ = updating;
+  }
+#else
+  void OnSizeChanged() {
+    SetViewport(offset_, scroll_->GetBounds().height());
+  }
+
+  void PlatformInit() {}
+  void PlatformDestroy() {}
+  void ApplyScrollOffset() {}
+#endif
+
+  DataSource source_;
+  const float row_height_;
+  const int overscan_;
+
+  scoped_refptr<Scroll> scroll_;
+  scoped_refptr<Container> content_;
+
+  internal::RowHeights heights_;
+  std::vector<bool> measured_;
+
+  std::map<int, scoped_refptr<View>> rows_;  // Row index => view
+  std::vector<scoped_refptr<View>> free_;
+
+  int on_size_changed_id_;
+
+  double offset_ = 0;
+  double viewport_height_ = 0;
+  bool updating_ = false;
+
+  DISALLOW_COPY_AND_ASSIGN(ListView);
+};
+
+}  // namespace nu
+
+#endif  // NATIVEUI_LIST_VIEW_H_
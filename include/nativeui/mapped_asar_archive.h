@@ -0,0 +1,443 @@
+// Copyright 2018 Cheng Zhao. All rights reserved.
+// Use of this source code is governed by the license that can be found in the
+// LICENSE file.
+
+#ifndef NATIVEUI_MAPPED_ASAR_ARCHIVE_H_
+#define NATIVEUI_MAPPED_ASAR_ARCHIVE_H_
+
+#include <stdint.h>
+#include <string.h>
+
+#include <algorithm>
+#include <map>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "base/files/file_path.h"
+#include "base/json/json_reader.h"
+#include "base/logging.h"
+#include "base/macros.h"
+#include "base/memory/ref_counted.h"
+#include "base/strings/string_number_conversions.h"
+#include "base/strings/string_piece.h"
+#include "base/synchronization/lock.h"
+#include "base/values.h"
+#include "build/build_config.h"
+#include "nativeui/util/lz4_block.h"
+#include "nativeui/util/ref_counted_mapped_file.h"
+
+namespace nu {
+
+// An asar archive mapped into memory, with a flat hash index of its files.
+//
+// Unlike AsarArchive, the JSON header is only parsed once, when the archive is
+// first opened: every file is then entered in an open-addressing table keyed
+// by its full path, so GetFileInfo() is a single hash lookup. Archives are
+// shared process-wide, so any number of jobs on any thread read the same
+// mapping.
+//
+// Files may be stored compressed, split into blocks that are compressed on
+// their own with LZ4 so any part of a file can be read without decompressing
+// what comes before it. Such entries carry their block table in the header:
+//
+//   "app.js": {
+//     "size": 150000,  // Uncompressed.
+//     "offset": "0",
+//     "compression": {
+//       "algorithm": "lz4",
+//       "blockSize": 65536,  // Uncompressed size of every block but the last.
+//       "blocks": [20113, 19877, 6302]  // Compressed size of each block.
+//     }
+//   }
+//
+// A block whose compressed size equals its uncompressed size is stored as is.
+//
+// Archives are assumed not to change while the process runs. Archives in the
+// extended format, appended to an executable, are read with AsarArchive.
+class MappedAsarArchive : public base::RefCountedThreadSafe<MappedAsarArchive> {
+ public:
+  struct FileInfo {
+    uint32_t size = 0;      // Uncompressed.
+    uint64_t offset = 0;    // From the start of the archive file.
+    bool unpacked = false;  // Stored in the "<archive>.unpacked" directory.
+    uint32_t block_size = 0;   // Nonzero if the file is compressed.
+    uint32_t first_block = 0;  // Into the archive's block table.
+  };
+
+  // Return the archive at |path|, mapping and indexing it on first use.
+  // Returns nullptr if it can not be read.
+  static scoped_refptr<MappedAsarArchive> Open(const base::FilePath& path) {
+    static base::Lock* lock = new base::Lock;
+    static auto* archives =
+        new std::map<base::FilePath, scoped_refptr<MappedAsarArchive>>;
+    {
+      base::AutoLock auto_lock(*lock);
+      auto it = archives->find(path);
+      if (it != archives->end())
+        return it->second;
+    }
+
+    // Load without holding the lock; if another thread won the race, its
+    // archive is used.
+    scoped_refptr<MappedAsarArchive> archive(new MappedAsarArchive(path));
+    if (!archive->Load())
+      return nullptr;
+    base::AutoLock auto_lock(*lock);
+    return archives->emplace(path, std::move(archive)).first->second;
+  }
+
+  // Turn |path| into the form used by the index: relative to the archive's
+  // root, separated by "/", without "." and ".." components.
+  static std::string NormalizePath(base::StringPiece path) {
+    std::string result;
+    size_t start = 0;
+    while (start <= path.size()) {
+      size_t end = start;
+      while (end < path.size() && !IsSeparator(path[end]))
+        ++end;
+      base::StringPiece part = path.substr(start, end - start);
+      if (part == "..") {
+        size_t slash = result.rfind('/');
+        result.erase(slash == std::string::npos ? 0 : slash);
+      } else if (!part.empty() && part != ".") {
+        if (!result.empty())
+          result.push_back('/');
+        part.AppendToString(&result);
+      }
+      start = end + 1;
+    }
+    return result;
+  }
+
+  bool GetFileInfo(base::StringPiece path, FileInfo* info) const {
+    const Entry* entry = IsNormalized(path) ? Find(path)
+                                            : Find(NormalizePath(path));
+    if (!entry)
+      return false;
+    *info = entry->info;
+    return true;
+  }
+
+  // Return the content of a file that is neither unpacked nor compressed.
+  const uint8_t* GetData(const FileInfo& info) const {
+    if (info.unpacked || IsCompressed(info))
+      return nullptr;
+    return file_->front() + info.offset;
+  }
+
+  // Return the content of a file that is neither unpacked nor compressed
+  // without copying it; the returned memory keeps the mapping alive.
+  scoped_refptr<base::RefCountedMemory> GetBuffer(const FileInfo& info) const {
+    if (info.unpacked || IsCompressed(info))
+      return nullptr;
+    return base::MakeRefCounted<RefCountedMemorySlice>(
+        file_, static_cast<size_t>(info.offset), info.size);
+  }
+
+  static bool IsCompressed(const FileInfo& info) {
+    return info.block_size != 0;
+  }
+
+  static size_t GetBlockCount(const FileInfo& info) {
+    return (static_cast<size_t>(info.size) + info.block_size - 1) /
+           info.block_size;
+  }
+
+  // Uncompressed size of the |index|th block of a compressed file.
+  static size_t GetBlockSize(const FileInfo& info, size_t index) {
+    size_t begin = index * info.block_size;
+    return std::min<size_t>(info.block_size, info.size - begin);
+  }
+
+  // Decompress the |index|th block of a compressed file into |out|, which
+  // must hold GetBlockSize() bytes. Returns false if the block is corrupted.
+  bool ReadBlock(const FileInfo& info, size_t index, uint8_t* out) const {
+    DCHECK(IsCompressed(info));
+    DCHECK_LT(index, GetBlockCount(info));
+    uint64_t begin = blocks_[info.first_block + index];
+    size_t compressed_size =
+        static_cast<size_t>(blocks_[info.first_block + index + 1] - begin);
+    size_t size = GetBlockSize(info, index);
+    const uint8_t* data = file_->front() + begin;
+    if (compressed_size == size) {
+      memcpy(out, data, size);
+      return true;
+    }
+    return LZ4DecompressBlock(data, compressed_size, out, size);
+  }
+
+  const base::FilePath& path() const { return path_; }
+  size_t file_count() const { return entries_.size(); }
+
+ private:
+  friend class base::RefCountedThreadSafe<MappedAsarArchive>;
+
+  struct Entry {
+    uint64_t hash;
+    uint32_t key_offset;  // Into |keys_|.
+    uint32_t key_size;
+    FileInfo info;
+  };
+
+  // Links to other files are followed this many times at most.
+  static constexpr int kMaxLinkDepth = 8;
+
+  explicit MappedAsarArchive(const base::FilePath& path)
+      : path_(path), file_(base::MakeRefCounted<RefCountedMappedFile>()) {}
+  ~MappedAsarArchive() = default;
+
+  static bool IsSeparator(char c) {
+#if defined(OS_WIN)
+    return c == '/' || c == '\\';
+#else
+    return c == '/';
+#endif
+  }
+
+  // Whether NormalizePath() would return |path| unchanged, which is true for
+  // nearly every request, so lookups do not need to allocate.
+  static bool IsNormalized(base::StringPiece path) {
+    size_t start = 0;
+    while (start <= path.size()) {
+      size_t end = start;
+      while (end < path.size() && !IsSeparator(path[end]))
+        ++end;
+      if (end < path.size() && path[end] != '/')
+        return false;
+      base::StringPiece part = path.substr(start, end - start);
+      if (part.empty() || part == "." || part == "..")
+        return false;
+      start = end + 1;
+    }
+    return true;
+  }
+
+  // FNV-1a.
+  static uint64_t Hash(base::StringPiece key) {
+    uint64_t hash = 14695981039346656037ull;
+    for (char c : key) {
+      hash ^= static_cast<uint8_t>(c);
+      hash *= 1099511628211ull;
+    }
+    return hash;
+  }
+
+  base::StringPiece KeyOf(const Entry& entry) const {
+    return base::StringPiece(keys_.data() + entry.key_offset, entry.key_size);
+  }
+
+  const Entry* Find(base::StringPiece key) const {
+    if (slots_.empty())
+      return nullptr;
+    uint64_t hash = Hash(key);
+    size_t mask = slots_.size() - 1;
+    for (size_t i = hash & mask; slots_[i]; i = (i + 1) & mask) {
+      const Entry& entry = entries_[slots_[i] - 1];
+      if (entry.hash == hash && KeyOf(entry) == key)
+        return &entry;
+    }
+    return nullptr;
+  }
+
+  bool Load() {
+    if (!file_->Initialize(path_))
+      return false;
+
+    // The archive starts with two pickles: one holding the size of the
+    // second, and the second holding the JSON header.
+    const uint8_t* data = file_->front();
+    size_t length = file_->size();
+    uint32_t pickle_size, header_size, json_size;
+    if (length < 16)
+      return false;
+    memcpy(&pickle_size, data, 4);
+    memcpy(&header_size, data + 4, 4);
+    memcpy(&json_size, data + 12, 4);
+    if (pickle_size != 4 || header_size < 8 || header_size > length - 8 ||
+        json_size > header_size - 8)
+      return false;
+    uint64_t content_offset = 8 + static_cast<uint64_t>(header_size);
+
+    std::unique_ptr<base::Value> header = base::JSONReader::Read(
+        base::StringPiece(reinterpret_cast<const char*>(data + 16), json_size));
+    if (!header || !header->is_dict())
+      return false;
+
+    std::vector<std::pair<std::string, std::string>> links;
+    std::string prefix;
+    if (!AddDirectory(*header, content_offset, &prefix, &links))
+      return false;
+    ResolveLinks(links);
+    BuildTable();
+    return true;
+  }
+
+  // Add the files under |dir| to the index, with their paths starting with
+  // |prefix|.
+  bool AddDirectory(const base::Value& dir,
+                    uint64_t content_offset,
+                    std::string* prefix,
+                    std::vector<std::pair<std::string, std::string>>* links) {
+    const base::Value* files = dir.FindKeyOfType("files",
+                                                 base::Value::Type::DICTIONARY);
+    if (!files)
+      return false;
+    for (const auto& it : files->DictItems()) {
+      const base::Value& node = it.second;
+      if (!node.is_dict())
+        continue;
+      size_t prefix_size = prefix->size();
+      if (!prefix->empty())
+        prefix->push_back('/');
+      prefix->append(it.first);
+
+      if (node.FindKey("files")) {
+        if (!AddDirectory(node, content_offset, prefix, links))
+          return false;
+      } else if (const base::Value* link =
+                     node.FindKeyOfType("link", base::Value::Type::STRING)) {
+        links->emplace_back(*prefix, NormalizePath(link->GetString()));
+      } else {
+        FileInfo info;
+        if (!ReadFileInfo(node, content_offset, &info))
+          return false;
+        AddEntry(*prefix, info);
+      }
+      prefix->resize(prefix_size);
+    }
+    return true;
+  }
+
+  bool ReadFileInfo(const base::Value& node,
+                    uint64_t content_offset,
+                    FileInfo* info) {
+    const base::Value* size = node.FindKey("size");
+    if (!size || !(size->is_int() || size->is_double()) ||
+        size->GetDouble() < 0 || size->GetDouble() > UINT32_MAX)
+      return false;
+    info->size = static_cast<uint32_t>(size->GetDouble());
+
+    const base::Value* unpacked =
+        node.FindKeyOfType("unpacked", base::Value::Type::BOOLEAN);
+    info->unpacked = unpacked && unpacked->GetBool();
+    if (info->unpacked)
+      return true;
+
+    const base::Value* offset =
+        node.FindKeyOfType("offset", base::Value::Type::STRING);
+    uint64_t relative;
+    if (!offset || !base::StringToUint64(offset->GetString(), &relative))
+      return false;
+    info->offset = content_offset + relative;
+    if (info->offset > file_->size())
+      return false;
+
+    if (const base::Value* compression = node.FindKeyOfType(
+            "compression", base::Value::Type::DICTIONARY))
+      return ReadBlockTable(*compression, info);
+    return info->size <= file_->size() - info->offset;
+  }
+
+  // Append the offsets of a compressed file's blocks, and of their end, to
+  // |blocks_|.
+  bool ReadBlockTable(const base::Value& compression, FileInfo* info) {
+    const base::Value* algorithm =
+        compression.FindKeyOfType("algorithm", base::Value::Type::STRING);
+    const base::Value* block_size =
+        compression.FindKeyOfType("blockSize", base::Value::Type::INTEGER);
+    const base::Value* blocks =
+        compression.FindKeyOfType("blocks", base::Value::Type::LIST);
+    if (!algorithm || algorithm->GetString() != "lz4" || !block_size ||
+        block_size->GetInt() <= 0 || !blocks)
+      return false;
+    info->block_size = block_size->GetInt();
+    if (blocks->GetList().size() != GetBlockCount(*info))
+      return false;
+
+    size_t first_block = blocks_.size();
+    uint64_t offset = info->offset;
+    for (const base::Value& block : blocks->GetList()) {
+      if (!block.is_int() || block.GetInt() < 0 ||
+          static_cast<uint64_t>(block.GetInt()) > file_->size() - offset) {
+        blocks_.resize(first_block);
+        return false;
+      }
+      blocks_.push_back(offset);
+      offset += block.GetInt();
+    }
+    blocks_.push_back(offset);
+    info->first_block = static_cast<uint32_t>(first_block);
+    return true;
+  }
+
+  void AddEntry(const std::string& key, const FileInfo& info) {
+    Entry entry;
+    entry.hash = Hash(key);
+    entry.key_offset = static_cast<uint32_t>(keys_.size());
+    entry.key_size = static_cast<uint32_t>(key.size());
+    entry.info = info;
+    keys_.append(key);
+    entries_.push_back(entry);
+  }
+
+  // Give links the info of the files they point to. Links to directories are
+  // not supported.
+  void ResolveLinks(
+      const std::vector<std::pair<std::string, std::string>>& links) {
+    if (links.empty())
+      return;
+    std::map<std::string, std::string> targets(links.begin(), links.end());
+    std::map<std::string, const FileInfo*> files;
+    for (const Entry& entry : entries_)
+      files.emplace(KeyOf(entry).as_string(), &entry.info);
+
+    std::vector<std::pair<std::string, FileInfo>> resolved;
+    for (const auto& link : links) {
+      std::string target = link.second;
+      for (int i = 0; i < kMaxLinkDepth; ++i) {
+        auto file = files.find(target);
+        if (file != files.end()) {
+          resolved.emplace_back(link.first, *file->second);
+          break;
+        }
+        auto next = targets.find(target);
+        if (next == targets.end())
+          break;
+        target = next->second;
+      }
+    }
+    for (const auto& it : resolved)
+      AddEntry(it.first, it.second);
+  }
+
+  // Fill |slots_|, keeping it at most half full.
+  void BuildTable() {
+    size_t capacity = 16;
+    while (capacity < entries_.size() * 2)
+      capacity *= 2;
+    slots_.assign(capacity, 0);
+    size_t mask = capacity - 1;
+    for (size_t i = 0; i < entries_.size(); ++i) {
+      size_t slot = entries_[i].hash & mask;
+      while (slots_[slot])
+        slot = (slot + 1) & mask;
+      slots_[slot] = static_cast<uint32_t>(i + 1);
+    }
+  }
+
+  base::FilePath path_;
+  scoped_refptr<RefCountedMappedFile> file_;
+
+  std::string keys_;             // Paths of all entries, back to back.
+  std::vector<Entry> entries_;
+  std::vector<uint32_t> slots_;  // 1-based indices into |entries_|.
+  std::vector<uint64_t> blocks_;  // Offsets of compressed blocks.
+
+  DISALLOW_COPY_AND_ASSIGN(MappedAsarArchive);
+};
+
+}  // namespace nu
+
+#endif  // NATIVEUI_MAPPED_ASAR_ARCHIVE_H_
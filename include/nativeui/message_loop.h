@@ -5,10 +5,35 @@
 #ifndef NATIVEUI_MESSAGE_LOOP_H_
 #define NATIVEUI_MESSAGE_LOOP_H_
 
+#include <stdint.h>
+
+#include <algorithm>
+#include <atomic>
+#include <functional>
+#include <limits>
+#include <string>
 #include <unordered_map>
+#include <utility>
+#include <vector>
 
+#include "base/bind.h"
+#include "base/bits.h"
+#include "base/callback.h"
+#include "base/location.h"
+#include "base/memory/ref_counted.h"
+#include "base/message_loop/message_loop.h"
+#include "base/single_thread_task_runner.h"
 #include "base/synchronization/lock.h"
+#include "base/threading/thread_task_runner_handle.h"
+#include "base/time/time.h"
 #include "nativeui/nativeui_export.h"
+#include "nativeui/util/mpsc_queue.h"
+#include "nativeui/util/task_tracker.h"
+#include "nativeui/util/timer_wheel.h"
+
+#if defined(USE_GLIB)
+#include <glib.h>
+#endif
 
 namespace nu {
 
@@ -18,12 +43,95 @@ class NATIVEUI_EXPORT MessageLoop {
   // Function type for tasks.
   using Task = std::function<void()>;
 
+  // Function type for tasks that run once. Unlike Task it is never copied, so
+  // it can carry move-only state:
+  //   MessageLoop::PostTask(base::BindOnce(&ShowFrame, std::move(frame)));
+  using OnceTask = base::OnceClosure;
+
   // Control message loop.
   static void Run();
   static void Quit();
   static void PostTask(const Task& task);
   static void PostDelayedTask(int ms, const Task& task);
 
+  // Post a move-only task. Tasks posted from any number of threads are pushed
+  // to a lock-free queue, which the GUI thread drains in batches: a burst of
+  // posts costs at most one PostTask(const Task&) wakeup.
+  static void PostTask(OnceTask task);
+
+  // Priority lanes for PostTask(TaskPriority, OnceTask). Tasks of a lane run
+  // in posting order; a higher lane's tasks run before a lower lane's.
+  enum class TaskPriority {
+    kHigh,    // Input handling and other latency-sensitive work.
+    kNormal,  // The default, e.g. model updates.
+    kIdle,    // Background bookkeeping, run after paint for a limited time.
+  };
+
+  // Post a move-only task to the lane of |priority|.
+  static void PostTask(TaskPriority priority, OnceTask task);
+
+  // Set how long idle-priority tasks may run per wakeup before yielding to
+  // other work. Defaults to 5 milliseconds.
+  static void SetIdleTimeBudget(int ms);
+
+  // Refers to a task posted with PostDelayedTask(int, OnceTask, int).
+  class DelayedTaskHandle {
+   public:
+    DelayedTaskHandle() = default;
+
+    // Keep the task from running. Returns false if it has already run or
+    // been canceled.
+    bool Cancel();
+
+    // Whether the task is still waiting to run.
+    bool IsPending() const;
+
+   private:
+    friend class MessageLoop;
+
+    explicit DelayedTaskHandle(scoped_refptr<internal::TimerWheelEntry> entry)
+        : entry_(std::move(entry)) {}
+
+    scoped_refptr<internal::TimerWheelEntry> entry_;
+  };
+
+  // Post a move-only task that runs after |ms| milliseconds.
+  //
+  // All tasks posted this way share a timer wheel driven by a single native
+  // timer, instead of creating one native timer per task. |slack_ms| lets the
+  // task run up to that much later than requested, so that timers with
+  // nearby deadlines fire together.
+  static DelayedTaskHandle PostDelayedTask(int ms, OnceTask task,
+                                           int slack_ms = 0);
+
+  // Statistics of the tasks posted with the OnceTask overloads: how long they
+  // waited in their queue and how long they ran. The same numbers are recorded
+  // in the "NativeUI.MessageLoop.*" histograms of base::StatisticsRecorder.
+  static MessageLoopStats GetStats();
+
+  // Return the statistics and histograms as human-readable text.
+  static std::string DumpStats();
+
+  // Capture the stack of the GUI thread whenever a task runs for longer than
+  // |ms| milliseconds; the reports are kept in GetStats().long_tasks. Passing 0
+  // turns detection off. Must be called on the GUI thread. Meant for
+  // debugging: the capture is not async-signal-safe on POSIX, see TaskTracker.
+  static void SetLongTaskThreshold(int ms);
+
+  // Run the tasks posted with the OnceTask overloads through the
+  // base::MessageLoopForUI of the calling thread, which must be the GUI
+  // thread, instead of through native sources. They then share one queue and
+  // one wakeup with base::ThreadTaskRunnerHandle posts, and run in a
+  // consistent order with them.
+  //
+  // On GTK base::MessagePumpGlib also dispatches the GLib sources of GTK, so
+  // the app runs base::RunLoop instead of Run().
+  static void AttachToBaseMessageLoop();
+
+  // Go back to native sources. Must be called on the GUI thread, before the
+  // base::MessageLoopForUI is destroyed.
+  static void DetachFromBaseMessageLoop();
+
  private:
 #if defined(OS_WIN)
   static void CALLBACK OnTimer(HWND, UINT, UINT_PTR event, DWORD);
@@ -35,6 +143,373 @@ class NATIVEUI_EXPORT MessageLoop {
   DISALLOW_IMPLICIT_CONSTRUCTORS(MessageLoop);
 };
 
+namespace internal {
+
+// The base task runner set by MessageLoop::AttachToBaseMessageLoop().
+class AttachedTaskRunner {
+ public:
+  static AttachedTaskRunner* Get() {
+    static AttachedTaskRunner* runner = new AttachedTaskRunner;
+    return runner;
+  }
+
+  void Set(scoped_refptr<base::SingleThreadTaskRunner> runner) {
+    base::AutoLock auto_lock(lock_);
+    attached_.store(runner != nullptr);
+    runner_ = std::move(runner);
+  }
+
+  // Post |task| to the attached task runner. Returns false, dropping |task|,
+  // when there is none.
+  bool PostDelayedTask(base::OnceClosure task, base::TimeDelta delay) {
+    if (!attached_.load())
+      return false;
+    scoped_refptr<base::SingleThreadTaskRunner> runner;
+    {
+      base::AutoLock auto_lock(lock_);
+      runner = runner_;
+    }
+    return runner &&
+           runner->PostDelayedTask(FROM_HERE, std::move(task), delay);
+  }
+
+ private:
+  AttachedTaskRunner() = default;
+
+  std::atomic<bool> attached_{false};  // Skips the lock when not attached.
+  base::Lock lock_;
+  scoped_refptr<base::SingleThreadTaskRunner> runner_;
+
+  DISALLOW_COPY_AND_ASSIGN(AttachedTaskRunner);
+};
+
+// The queues behind MessageLoop::PostTask(TaskPriority, OnceTask), one lane
+// per priority.
+//
+// Each lane is a lock-free queue with its own wakeup. With GLib the wakeups
+// are idle sources at the lane's GLib priority, so GLib itself orders lanes
+// against input, redraw and other sources. Elsewhere the wakeups go through
+// PostTask(const Task&), and lower lanes yield as soon as a higher lane has
+// work, which keeps high-priority tasks at most one task away.
+class OnceTaskQueue {
+ public:
+  using TaskPriority = MessageLoop::TaskPriority;
+
+  static OnceTaskQueue* Get() {
+    static OnceTaskQueue* queue = new OnceTaskQueue;
+    return queue;
+  }
+
+  void Post(TaskPriority priority, MessageLoop::OnceTask task) {
+    Lane& lane = lanes_[static_cast<int>(priority)];
+    Node* node = pool_.Acquire();
+    node->task = std::move(task);
+    node->posted_at = base::TimeTicks::Now();
+    lane.queue.Push(node);
+    if (!lane.wakeup_pending.exchange(true))
+      Wakeup(priority);
+  }
+
+  void set_idle_time_budget(base::TimeDelta budget) {
+    idle_budget_us_.store(budget.InMicroseconds());
+  }
+
+  // Post the wakeups again after switching between native sources and an
+  // attached task runner, since the old ones may never run.
+  void RepostWakeups() {
+    for (int i = 0; i < kLaneCount; ++i) {
+      if (lanes_[i].wakeup_pending.load())
+        Wakeup(static_cast<TaskPriority>(i));
+    }
+  }
+
+ private:
+  struct Node : MPSCNode {
+    MessageLoop::OnceTask task;
+    base::TimeTicks posted_at;
+  };
+
+  struct Lane {
+    MPSCQueue<Node> queue;
+    std::atomic<bool> wakeup_pending{false};
+  };
+
+  static constexpr int kLaneCount = 3;
+
+  // Upper bound of tasks run per wakeup, so a flood of posts from a worker
+  // does not starve input and paint events.
+  static constexpr int kMaxTasksPerWakeup = 64;
+
+  OnceTaskQueue() = default;
+
+  static void Wakeup(TaskPriority priority) {
+    // With a task runner attached, lanes keep their order by yielding to each
+    // other as they do without GLib.
+    if (AttachedTaskRunner::Get()->PostDelayedTask(
+            base::BindOnce(&OnceTaskQueue::RunLaneAt, priority),
+            base::TimeDelta()))
+      return;
+#if defined(USE_GLIB)
+    static const gint kGlibPriorities[kLaneCount] = {
+      G_PRIORITY_HIGH, G_PRIORITY_DEFAULT, G_PRIORITY_DEFAULT_IDLE,
+    };
+    g_idle_add_full(kGlibPriorities[static_cast<int>(priority)],
+                    &OnceTaskQueue::OnGlibWakeup,
+                    reinterpret_cast<gpointer>(static_cast<intptr_t>(priority)),
+                    nullptr);
+#else
+    switch (priority) {
+      case TaskPriority::kHigh:
+        MessageLoop::PostTask(&OnceTaskQueue::RunLane<TaskPriority::kHigh>);
+        break;
+      case TaskPriority::kNormal:
+        MessageLoop::PostTask(&OnceTaskQueue::RunLane<TaskPriority::kNormal>);
+        break;
+      case TaskPriority::kIdle:
+        MessageLoop::PostTask(&OnceTaskQueue::RunLane<TaskPriority::kIdle>);
+        break;
+    }
+#endif
+  }
+
+#if defined(USE_GLIB)
+  static gboolean OnGlibWakeup(gpointer data) {
+    Get()->Run(static_cast<TaskPriority>(reinterpret_cast<intptr_t>(data)));
+    return G_SOURCE_REMOVE;
+  }
+#endif
+
+  template <TaskPriority kPriority>
+  static void RunLane() {
+    Get()->Run(kPriority);
+  }
+
+  static void RunLaneAt(TaskPriority priority) {
+    Get()->Run(priority);
+  }
+
+  // Whether a lane above |priority| is waiting to run.
+  bool HasHigherPriorityWork(TaskPriority priority) const {
+    for (int i = 0; i < static_cast<int>(priority); ++i) {
+      if (lanes_[i].wakeup_pending.load())
+        return true;
+    }
+    return false;
+  }
+
+  void Run(TaskPriority priority) {
+    Lane& lane = lanes_[static_cast<int>(priority)];
+    // Clear the flag before popping: a task pushed from now on posts a new
+    // wakeup, a task pushed before is visible to Pop().
+    lane.wakeup_pending.exchange(false);
+
+    // Idle tasks get a time budget per wakeup, like requestIdleCallback.
+    base::TimeTicks deadline = base::TimeTicks::Max();
+    if (priority == TaskPriority::kIdle)
+      deadline = base::TimeTicks::Now() +
+                 base::TimeDelta::FromMicroseconds(idle_budget_us_.load());
+
+    for (int i = 0; i < kMaxTasksPerWakeup; ++i) {
+      if (HasHigherPriorityWork(priority) ||
+          (i > 0 && base::TimeTicks::Now() >= deadline))
+        break;
+      Node* node = lane.queue.Pop();
+      if (!node)
+        return;
+      MessageLoop::OnceTask task = std::move(node->task);
+      base::TimeTicks posted_at = node->posted_at;
+      pool_.Release(node);
+      TaskTracker::Get()->RunTask(static_cast<TaskSource>(priority),
+                                  base::TimeTicks::Now() - posted_at,
+                                  std::move(task));
+    }
+    if (!lane.wakeup_pending.exchange(true))
+      Wakeup(priority);
+  }
+
+  Lane lanes_[kLaneCount];
+  MPSCNodePool<Node> pool_;
+  std::atomic<int64_t> idle_budget_us_{5000};
+
+  DISALLOW_COPY_AND_ASSIGN(OnceTaskQueue);
+};
+
+// The timer wheel behind MessageLoop::PostDelayedTask(int, OnceTask, int).
+// Ticks are milliseconds of base::TimeTicks.
+class DelayedTaskScheduler {
+ public:
+  static DelayedTaskScheduler* Get() {
+    static DelayedTaskScheduler* scheduler = new DelayedTaskScheduler;
+    return scheduler;
+  }
+
+  scoped_refptr<TimerWheelEntry> Post(int ms, MessageLoop::OnceTask task,
+                                      int slack_ms) {
+    uint64_t deadline = Now() + std::max(ms, 0);
+    // Round up to a power of two no larger than the slack, so timers with
+    // close deadlines land in the same tick.
+    if (slack_ms > 0) {
+      uint64_t granularity = uint64_t{1} << base::bits::Log2Floor(
+          static_cast<uint32_t>(slack_ms) + 1);
+      deadline = (deadline + granularity - 1) & ~(granularity - 1);
+    }
+
+    auto entry = base::MakeRefCounted<TimerWheelEntry>(deadline,
+                                                       std::move(task));
+    base::AutoLock auto_lock(lock_);
+    wheel_.Add(entry.get());
+    ArmLocked();
+    return entry;
+  }
+
+  bool Cancel(TimerWheelEntry* entry) {
+    base::AutoLock auto_lock(lock_);
+    wheel_.Remove(entry);
+    // An expired entry may still be waiting in OnTimer()'s list.
+    bool pending = !entry->task().is_null();
+    entry->task().Reset();
+    return pending;
+  }
+
+  bool IsPending(TimerWheelEntry* entry) {
+    base::AutoLock auto_lock(lock_);
+    return !entry->task().is_null();
+  }
+
+  // Arm a new native timer after switching between native sources and an
+  // attached task runner; the old one is ignored if it fires.
+  void Rearm() {
+    base::AutoLock auto_lock(lock_);
+    armed_ = false;
+    ++generation_;
+    ArmLocked();
+  }
+
+ private:
+  DelayedTaskScheduler() : wheel_(Now()) {}
+
+  static uint64_t Now() {
+    return (base::TimeTicks::Now() - base::TimeTicks()).InMilliseconds();
+  }
+
+  // Make sure the native timer fires by the wheel's next event. A timer that
+  // was armed for a later tick is left to fire and ignored.
+  void ArmLocked() {
+    uint64_t next = wheel_.NextEventTick();
+    if (next == std::numeric_limits<uint64_t>::max() ||
+        (armed_ && next >= armed_tick_))
+      return;
+
+    armed_ = true;
+    armed_tick_ = next;
+    int generation = ++generation_;
+    uint64_t now = Now();
+    int delay = next > now ? static_cast<int>(next - now) : 0;
+    if (AttachedTaskRunner::Get()->PostDelayedTask(
+            base::BindOnce(&DelayedTaskScheduler::OnTimerAt, generation),
+            base::TimeDelta::FromMilliseconds(delay)))
+      return;
+    MessageLoop::PostDelayedTask(delay, [generation]() {
+      Get()->OnTimer(generation);
+    });
+  }
+
+  static void OnTimerAt(int generation) {
+    Get()->OnTimer(generation);
+  }
+
+  void OnTimer(int generation) {
+    std::vector<scoped_refptr<TimerWheelEntry>> expired;
+    {
+      base::AutoLock auto_lock(lock_);
+      if (generation != generation_)
+        return;
+      armed_ = false;
+      wheel_.Advance(Now(), &expired);
+      ArmLocked();
+    }
+
+    for (const auto& entry : expired) {
+      MessageLoop::OnceTask task;
+      {
+        base::AutoLock auto_lock(lock_);
+        task = std::move(entry->task());
+      }
+      if (task.is_null())
+        continue;
+      uint64_t now = Now();
+      base::TimeDelta lateness = base::TimeDelta::FromMilliseconds(
+          now > entry->deadline() ? now - entry->deadline() : 0);
+      TaskTracker::Get()->RunTask(TaskSource::kDelayed, lateness,
+                                  std::move(task));
+    }
+  }
+
+  base::Lock lock_;
+  TimerWheel wheel_;
+  bool armed_ = false;
+  uint64_t armed_tick_ = 0;
+  int generation_ = 0;
+
+  DISALLOW_COPY_AND_ASSIGN(DelayedTaskScheduler);
+};
+
+}  // namespace internal
+
+inline void MessageLoop::PostTask(OnceTask task) {
+  PostTask(TaskPriority::kNormal, std::move(task));
+}
+
+inline void MessageLoop::PostTask(TaskPriority priority, OnceTask task) {
+  internal::OnceTaskQueue::Get()->Post(priority, std::move(task));
+}
+
+inline void MessageLoop::SetIdleTimeBudget(int ms) {
+  internal::OnceTaskQueue::Get()->set_idle_time_budget(
+      base::TimeDelta::FromMilliseconds(ms));
+}
+
+inline MessageLoop::DelayedTaskHandle MessageLoop::PostDelayedTask(
+    int ms, OnceTask task, int slack_ms) {
+  return DelayedTaskHandle(internal::DelayedTaskScheduler::Get()->Post(
+      ms, std::move(task), slack_ms));
+}
+
+inline MessageLoopStats MessageLoop::GetStats() {
+  return internal::TaskTracker::Get()->GetStats();
+}
+
+inline std::string MessageLoop::DumpStats() {
+  return internal::TaskTracker::Get()->DumpStats();
+}
+
+inline void MessageLoop::SetLongTaskThreshold(int ms) {
+  internal::TaskTracker::Get()->SetLongTaskThreshold(
+      base::TimeDelta::FromMilliseconds(ms));
+}
+
+inline void MessageLoop::AttachToBaseMessageLoop() {
+  DCHECK(base::MessageLoopForUI::IsCurrent());
+  internal::AttachedTaskRunner::Get()->Set(base::ThreadTaskRunnerHandle::Get());
+  internal::OnceTaskQueue::Get()->RepostWakeups();
+  internal::DelayedTaskScheduler::Get()->Rearm();
+}
+
+inline void MessageLoop::DetachFromBaseMessageLoop() {
+  internal::AttachedTaskRunner::Get()->Set(nullptr);
+  internal::OnceTaskQueue::Get()->RepostWakeups();
+  internal::DelayedTaskScheduler::Get()->Rearm();
+}
+
+inline bool MessageLoop::DelayedTaskHandle::Cancel() {
+  return entry_ && internal::DelayedTaskScheduler::Get()->Cancel(entry_.get());
+}
+
+inline bool MessageLoop::DelayedTaskHandle::IsPending() const {
+  return entry_ &&
+         internal::DelayedTaskScheduler::Get()->IsPending(entry_.get());
+}
+
 }  // namespace nu
 
 #endif  // NATIVEUI_MESSAGE_LOOP_H_
@@ -6,12 +6,16 @@
 #define NATIVEUI_NATIVEUI_H_
 
 #include "nativeui/app.h"
+#include "nativeui/batched_bindings.h"
 #include "nativeui/browser.h"
+#include "nativeui/browser_pool.h"
 #include "nativeui/button.h"
+#include "nativeui/container_hit_tester.h"
 #include "nativeui/entry.h"
 #include "nativeui/events/event.h"
 #include "nativeui/events/keyboard_code_conversion.h"
 #include "nativeui/events/keyboard_codes.h"
+#include "nativeui/events/mouse_move_coalescer.h"
 #include "nativeui/file_open_dialog.h"
 #include "nativeui/file_save_dialog.h"
 #include "nativeui/gfx/canvas.h"
@@ -19,8 +23,10 @@
 #include "nativeui/gfx/geometry/insets.h"
 #include "nativeui/gfx/image.h"
 #include "nativeui/gfx/painter.h"
+#include "nativeui/gfx/spatial_index.h"
 #include "nativeui/group.h"
 #include "nativeui/label.h"
+#include "nativeui/list_view.h"
 #include "nativeui/lifetime.h"
 #include "nativeui/menu.h"
 #include "nativeui/menu_bar.h"
@@ -28,6 +34,13 @@
 #include "nativeui/message_loop.h"
 #include "nativeui/progress_bar.h"
 #include "nativeui/protocol_asar_job.h"
+#include "nativeui/protocol_async_job.h"
+#include "nativeui/protocol_mapped_asar_job.h"
+#include "nativeui/protocol_mapped_file_job.h"
+#include "nativeui/protocol_memory_job.h"
+#include "nativeui/protocol_range_job.h"
+#include "nativeui/protocol_response_cache.h"
+#include "nativeui/script_queue.h"
 #include "nativeui/scroll.h"
 #include "nativeui/state.h"
 #include "nativeui/text_edit.h"
@@ -0,0 +1,284 @@
+// Copyright 2018 Cheng Zhao. All rights reserved.
+// Use of this source code is governed by the license that can be found in the
+// LICENSE file.
+
+#ifndef NATIVEUI_PROTOCOL_ASYNC_JOB_H_
+#define NATIVEUI_PROTOCOL_ASYNC_JOB_H_
+
+#include <string.h>
+
+#include <algorithm>
+#include <functional>
+#include <memory>
+#include <string>
+#include <utility>
+
+#include "base/bind.h"
+#include "base/logging.h"
+#include "base/memory/ref_counted.h"
+#include "base/sequenced_task_runner.h"
+#include "base/synchronization/condition_variable.h"
+#include "base/synchronization/lock.h"
+#include "base/task_scheduler/post_task.h"
+#include "nativeui/message_loop.h"
+#include "nativeui/protocol_job.h"
+
+#if defined(OS_LINUX)
+#include <glib.h>
+#endif
+
+namespace nu {
+
+namespace internal {
+
+// State shared by a ProtocolAsyncJob and the tasks running its job. The job
+// itself is only touched on |runner_|; its content goes through a ring
+// buffer guarded by |lock_|.
+class AsyncJobCore : public base::RefCountedThreadSafe<AsyncJobCore> {
+ public:
+  using Factory = std::function<ProtocolJob*()>;
+
+  // Size of the reads of the job.
+  static constexpr size_t kReadSize = 64 * 1024;
+
+  explicit AsyncJobCore(size_t capacity)
+      : runner_(base::CreateSequencedTaskRunnerWithTraits(
+            {base::MayBlock(), base::TaskPriority::USER_VISIBLE,
+             base::TaskShutdownBehavior::SKIP_ON_SHUTDOWN})),
+        readable_(&lock_),
+        buffer_(new uint8_t[capacity]),
+        capacity_(capacity) {}
+
+  void Start(Factory factory, std::function<void(int)> on_started) {
+    {
+      base::AutoLock auto_lock(notify_lock_);
+      on_started_ = std::move(on_started);
+    }
+    runner_->PostTask(FROM_HERE, base::BindOnce(&AsyncJobCore::StartOnSequence,
+                                                this, std::move(factory)));
+  }
+
+  void Kill() {
+    {
+      base::AutoLock auto_lock(notify_lock_);
+      on_started_ = nullptr;
+    }
+    {
+      base::AutoLock auto_lock(lock_);
+      if (killed_)
+        return;
+      killed_ = true;
+    }
+    readable_.Broadcast();
+    runner_->PostTask(FROM_HERE,
+                      base::BindOnce(&AsyncJobCore::KillOnSequence, this));
+  }
+
+  bool GetMimeType(std::string* mime_type) {
+    base::AutoLock auto_lock(lock_);
+    if (!started_ || mime_type_.empty())
+      return false;
+    *mime_type = mime_type_;
+    return true;
+  }
+
+  // Take what the read-ahead has buffered, waiting only when it is empty.
+  // Blocks, so it must not be called on the GUI thread.
+  size_t Read(void* buf, size_t buf_size) {
+#if defined(OS_LINUX)
+    // The GUI thread owns the default main context while dispatching.
+    DCHECK(!g_main_context_is_owner(g_main_context_default()))
+        << "ProtocolAsyncJob::Read() called on the GUI thread";
+#endif
+    base::AutoLock auto_lock(lock_);
+    while (size_ == 0 && !eof_ && !killed_)
+      readable_.Wait();
+    size_t size = std::min(buf_size, size_);
+    size_t first = std::min(size, capacity_ - head_);
+    memcpy(buf, buffer_.get() + head_, first);
+    memcpy(static_cast<uint8_t*>(buf) + first, buffer_.get(), size - first);
+    head_ = (head_ + size) % capacity_;
+    size_ -= size;
+    // Refill once half of the buffer has been consumed.
+    if (!filling_ && !eof_ && !killed_ && size_ <= capacity_ / 2) {
+      filling_ = true;
+      runner_->PostTask(FROM_HERE,
+                        base::BindOnce(&AsyncJobCore::FillOnSequence, this));
+    }
+    return size;
+  }
+
+ private:
+  friend class base::RefCountedThreadSafe<AsyncJobCore>;
+
+  ~AsyncJobCore() = default;
+
+  void StartOnSequence(Factory factory) {
+    job_ = factory();
+    if (job_) {
+      job_->Plug([this](int length) { length_ = length; });
+      std::string mime_type;
+      if (job_->Start() && job_->GetMimeType(&mime_type)) {
+        base::AutoLock auto_lock(lock_);
+        started_ = true;
+        mime_type_ = std::move(mime_type);
+        filling_ = true;
+      } else {
+        length_ = 0;
+      }
+    }
+    bool started;
+    {
+      base::AutoLock auto_lock(lock_);
+      if (!started_)
+        eof_ = true;
+      started = started_;
+    }
+    readable_.Broadcast();
+
+    // A job failing to start can not fail the request anymore, since Start()
+    // has already returned; it serves an empty response instead.
+    MessageLoop::PostTask(
+        MessageLoop::TaskPriority::kHigh,
+        base::BindOnce(&AsyncJobCore::NotifyStarted, this, length_));
+    if (started)
+      FillOnSequence();
+  }
+
+  void NotifyStarted(int length) {
+    base::AutoLock auto_lock(notify_lock_);
+    if (on_started_) {
+      on_started_(length);
+      on_started_ = nullptr;
+    }
+  }
+
+  // Read from the job until the buffer is full, straight into its free part.
+  void FillOnSequence() {
+    for (;;) {
+      uint8_t* dest;
+      size_t space;
+      {
+        base::AutoLock auto_lock(lock_);
+        if (killed_ || eof_ || size_ == capacity_) {
+          filling_ = false;
+          return;
+        }
+        size_t tail = (head_ + size_) % capacity_;
+        dest = buffer_.get() + tail;
+        space = std::min(std::min(capacity_ - tail, capacity_ - size_),
+                         size_t{kReadSize});
+      }
+      size_t read = job_->Read(dest, space);
+      {
+        base::AutoLock auto_lock(lock_);
+        if (read == 0)
+          eof_ = true;
+        size_ += read;
+      }
+      readable_.Broadcast();
+    }
+  }
+
+  void KillOnSequence() {
+    if (job_) {
+      job_->Kill();
+      job_ = nullptr;
+    }
+  }
+
+  scoped_refptr<base::SequencedTaskRunner> runner_;
+  scoped_refptr<ProtocolJob> job_;
+  int length_ = 0;  // Reported by |job_| when it starts.
+
+  base::Lock notify_lock_;
+  std::function<void(int)> on_started_;
+
+  base::Lock lock_;
+  base::ConditionVariable readable_;
+  std::unique_ptr<uint8_t[]> buffer_;
+  const size_t capacity_;
+  size_t head_ = 0;
+  size_t size_ = 0;
+  bool started_ = false;
+  bool filling_ = false;
+  bool eof_ = false;
+  bool killed_ = false;
+  std::string mime_type_;
+
+  DISALLOW_COPY_AND_ASSIGN(AsyncJobCore);
+};
+
+}  // namespace internal
+
+// Create, start and read another job on a base::TaskScheduler sequence, so
+// file I/O and decryption do not block the UI thread.
+//
+// The job's content is read ahead into a bounded buffer, which is refilled
+// once half of it has been consumed. The start of the job is posted back to
+// the MessageLoop.
+//
+// Read() is not asynchronous: it waits for the read-ahead when the buffer is
+// empty, so it must be called off the GUI thread. On GTK this holds for
+// nu_protocol_stream_new(), which Browser and ProtocolSchemeRequest::Finish()
+// serve jobs through: WebKit reads it with g_input_stream_read_async(), which
+// runs the read on a GIO worker thread for streams that are not pollable.
+// Debug builds check it there.
+//
+// The TaskScheduler must have been started, e.g. with
+// base::TaskScheduler::CreateAndStartWithDefaultParams().
+class ProtocolAsyncJob : public ProtocolJob {
+ public:
+  using Handler = std::function<ProtocolJob*(const std::string&)>;
+
+  static constexpr size_t kDefaultReadAhead = 256 * 1024;
+
+  // Turn a handler for Browser::RegisterProtocol() into one whose jobs run
+  // off the UI thread. |handler| is then called on the sequence, so it must
+  // not use the UI.
+  static Handler WrapHandler(Handler handler,
+                             size_t read_ahead = kDefaultReadAhead) {
+    return [handler, read_ahead](const std::string& url) -> ProtocolJob* {
+      return new ProtocolAsyncJob(std::bind(handler, url), read_ahead);
+    };
+  }
+
+  // |factory| is called on the sequence to create the job.
+  explicit ProtocolAsyncJob(std::function<ProtocolJob*()> factory,
+                            size_t read_ahead = kDefaultReadAhead)
+      : factory_(std::move(factory)),
+        core_(new internal::AsyncJobCore(read_ahead)) {}
+
+  // ProtocolJob:
+  bool Start() override {
+    core_->Start(std::move(factory_),
+                 [this](int length) { notify_content_length(length); });
+    return true;
+  }
+
+  void Kill() override {
+    core_->Kill();
+    ProtocolJob::Kill();
+  }
+
+  bool GetMimeType(std::string* mime_type) override {
+    return core_->GetMimeType(mime_type);
+  }
+
+  size_t Read(void* buf, size_t buf_size) override {
+    return core_->Read(buf, buf_size);
+  }
+
+ protected:
+  ~ProtocolAsyncJob() override { core_->Kill(); }
+
+ private:
+  std::function<ProtocolJob*()> factory_;
+  scoped_refptr<internal::AsyncJobCore> core_;
+
+  DISALLOW_COPY_AND_ASSIGN(ProtocolAsyncJob);
+};
+
+}  // namespace nu
+
+#endif  // NATIVEUI_PROTOCOL_ASYNC_JOB_H_
@@ -0,0 +1,292 @@
+// Copyright 2018 Cheng Zhao. All rights reserved.
+// Use of this source code is governed by the license that can be found in the
+// LICENSE file.
+
+#ifndef NATIVEUI_PROTOCOL_MAPPED_ASAR_JOB_H_
+#define NATIVEUI_PROTOCOL_MAPPED_ASAR_JOB_H_
+
+#include <string.h>
+
+#include <algorithm>
+#include <memory>
+#include <string>
+
+#include "nativeui/mapped_asar_archive.h"
+#include "nativeui/protocol_seekable_file_job.h"
+#include "nativeui/util/aes_cbc_decryptor.h"
+
+namespace nu {
+
+// Serve a file of an asar archive from the process-wide MappedAsarArchive,
+// instead of opening and parsing the archive for every request like
+// ProtocolAsarJob does. Compressed files are decompressed one block at a
+// time as they are read.
+class ProtocolMappedAsarJob : public ProtocolSeekableFileJob {
+ public:
+  // The file's extension is used to determine the MIME type.
+  ProtocolMappedAsarJob(const base::FilePath& asar, const std::string& path)
+      : ProtocolSeekableFileJob(base::FilePath::FromUTF8Unsafe(path)),
+        asar_(asar),
+        path_in_archive_(path) {}
+
+  // Decrypt the file with AES-128-CBC and PKCS#7 padding, like
+  // ProtocolAsarJob::SetDecipher(). Must be called before Start(). Unpacked
+  // files are not encrypted and are served as they are; compressed files
+  // can not be encrypted.
+  bool SetDecipher(const std::string& key, const std::string& iv) {
+    std::unique_ptr<AESCBCDecryptor> decryptor(new AESCBCDecryptor);
+    if (!decryptor->Init(key, iv))
+      return false;
+    decryptor_ = std::move(decryptor);
+    key_ = key;
+    iv_ = iv;
+    return true;
+  }
+
+  // ProtocolJob:
+  bool Start() override {
+    archive_ = MappedAsarArchive::Open(asar_);
+    if (!archive_ || !archive_->GetFileInfo(path_in_archive_, &info_))
+      return false;
+    if (decryptor_ && MappedAsarArchive::IsCompressed(info_))
+      return false;
+    if (decryptor_ && !info_.unpacked) {
+      if (!ReadPlainSize())
+        return false;
+    } else if (info_.unpacked) {
+      base::FilePath unpacked =
+          asar_.AddExtension(FILE_PATH_LITERAL("unpacked"))
+               .Append(base::FilePath::FromUTF8Unsafe(
+                   MappedAsarArchive::NormalizePath(path_in_archive_)));
+      file_.Initialize(unpacked, base::File::FLAG_OPEN | base::File::FLAG_READ);
+      if (!file_.IsValid())
+        return false;
+    }
+    if (!IsEncrypted())
+      plain_size_ = info_.size;
+    content_length_ = plain_size_;
+    notify_content_length(static_cast<int>(content_length_));
+    return true;
+  }
+
+  void Kill() override {
+    ProtocolFileJob::Kill();
+    archive_ = nullptr;
+  }
+
+  // Return the file's content without copying it, or nullptr if the file is
+  // unpacked or encrypted. Can be used instead of Read() after Start()
+  // succeeded.
+  scoped_refptr<base::RefCountedMemory> GetDirectBuffer() const {
+    return archive_ && !IsEncrypted() ? archive_->GetBuffer(info_) : nullptr;
+  }
+
+  size_t Read(void* buf, size_t buf_size) override {
+    if (!archive_)
+      return 0;
+    if (IsEncrypted())
+      return ReadEncrypted(static_cast<uint8_t*>(buf), buf_size);
+    if (MappedAsarArchive::IsCompressed(info_))
+      return ReadCompressed(static_cast<uint8_t*>(buf), buf_size);
+    size_t size = std::min<uint64_t>(buf_size, info_.size - pos_);
+    if (info_.unpacked) {
+      int read = file_.ReadAtCurrentPos(static_cast<char*>(buf),
+                                        static_cast<int>(size));
+      size = read > 0 ? read : 0;
+    } else {
+      memcpy(buf, archive_->GetData(info_) + pos_, size);
+    }
+    pos_ += size;
+    return size;
+  }
+
+  // ProtocolSeekableFileJob:
+  bool Seek(uint64_t offset) override {
+    if (!archive_ || offset > plain_size_)
+      return false;
+    if (IsEncrypted())
+      return SeekEncrypted(offset);
+    if (MappedAsarArchive::IsCompressed(info_))
+      return SeekCompressed(offset);
+    if (info_.unpacked &&
+        file_.Seek(base::File::FROM_BEGIN, static_cast<int64_t>(offset)) !=
+            static_cast<int64_t>(offset))
+      return false;
+    pos_ = offset;
+    return true;
+  }
+
+ protected:
+  ~ProtocolMappedAsarJob() override = default;
+
+  bool IsEncrypted() const { return decryptor_ && !info_.unpacked; }
+
+  // The plaintext is shorter than the ciphertext by its padding, which is
+  // found by decrypting only the last block.
+  bool ReadPlainSize() {
+    if (info_.size == 0 || info_.size % AES_BLOCKLEN != 0)
+      return false;
+    const uint8_t* data = archive_->GetData(info_);
+    const uint8_t* last = data + info_.size - AES_BLOCKLEN;
+    std::string iv = info_.size == AES_BLOCKLEN ?
+        iv_ : std::string(reinterpret_cast<const char*>(last - AES_BLOCKLEN),
+                          AES_BLOCKLEN);
+    AESCBCDecryptor decryptor;
+    if (!decryptor.Init(key_, iv))
+      return false;
+    uint8_t block[AES_BLOCKLEN];
+    memcpy(block, last, AES_BLOCKLEN);
+    decryptor.DecryptBuffer(block, AES_BLOCKLEN);
+    uint8_t padding = block[AES_BLOCKLEN - 1];
+    if (padding == 0 || padding > AES_BLOCKLEN)
+      return false;
+    for (size_t i = AES_BLOCKLEN - padding; i < AES_BLOCKLEN; ++i) {
+      if (block[i] != padding)
+        return false;
+    }
+    plain_size_ = info_.size - padding;
+    return true;
+  }
+
+  // CBC can restart at any block, with the previous ciphertext block as IV.
+  bool SeekEncrypted(uint64_t offset) {
+    uint64_t block = offset - offset % AES_BLOCKLEN;
+    const uint8_t* data = archive_->GetData(info_);
+    std::string iv = block == 0 ?
+        iv_ : std::string(reinterpret_cast<const char*>(data + block) -
+                          AES_BLOCKLEN, AES_BLOCKLEN);
+    if (!decryptor_->Init(key_, iv))
+      return false;
+    cipher_pos_ = block;
+    pending_pos_ = pending_end_ = 0;
+    pos_ = block;
+    size_t skip = static_cast<size_t>(offset - block);
+    if (skip > 0) {
+      memcpy(pending_, data + cipher_pos_, AES_BLOCKLEN);
+      decryptor_->DecryptBuffer(pending_, AES_BLOCKLEN);
+      cipher_pos_ += AES_BLOCKLEN;
+      pending_pos_ = skip;
+      pending_end_ = AES_BLOCKLEN;
+      pos_ = offset;
+    }
+    return true;
+  }
+
+  // Whole blocks are decrypted in place in |buf|; a block that does not fit
+  // is decrypted into |pending_| and handed out by the following reads.
+  size_t ReadEncrypted(uint8_t* buf, size_t buf_size) {
+    size_t size = 0;
+    if (pending_pos_ < pending_end_) {
+      size = std::min(buf_size, pending_end_ - pending_pos_);
+      memcpy(buf, pending_ + pending_pos_, size);
+      pending_pos_ += size;
+    }
+
+    const uint8_t* data = archive_->GetData(info_);
+    uint64_t cipher_left = info_.size - cipher_pos_;
+    size_t blocks = static_cast<size_t>(
+        std::min<uint64_t>((buf_size - size) / AES_BLOCKLEN,
+                           cipher_left / AES_BLOCKLEN));
+    if (blocks > 0) {
+      size_t length = blocks * AES_BLOCKLEN;
+      memcpy(buf + size, data + cipher_pos_, length);
+      decryptor_->DecryptBuffer(buf + size, length);
+      cipher_pos_ += length;
+      size += length;
+    }
+
+    if (size < buf_size && cipher_pos_ < info_.size) {
+      memcpy(pending_, data + cipher_pos_, AES_BLOCKLEN);
+      decryptor_->DecryptBuffer(pending_, AES_BLOCKLEN);
+      cipher_pos_ += AES_BLOCKLEN;
+      pending_end_ = AES_BLOCKLEN;
+      pending_pos_ = std::min(buf_size - size, pending_end_);
+      memcpy(buf + size, pending_, pending_pos_);
+      size += pending_pos_;
+    }
+
+    // Never hand out the padding.
+    size = static_cast<size_t>(std::min<uint64_t>(size, plain_size_ - pos_));
+    pos_ += size;
+    return size;
+  }
+
+  bool SeekCompressed(uint64_t offset) {
+    next_block_ = static_cast<size_t>(offset / info_.block_size);
+    block_pos_ = block_end_ = 0;
+    pos_ = offset - offset % info_.block_size;
+    size_t skip = static_cast<size_t>(offset - pos_);
+    if (skip > 0) {
+      if (!block_)
+        block_.reset(new uint8_t[info_.block_size]);
+      if (!archive_->ReadBlock(info_, next_block_, block_.get()))
+        return false;
+      block_pos_ = skip;
+      block_end_ = MappedAsarArchive::GetBlockSize(info_, next_block_++);
+      pos_ = offset;
+    }
+    return true;
+  }
+
+  // Blocks that fit are decompressed straight into |buf|, others into
+  // |block_| and handed out by the following reads. A corrupted block ends
+  // the content early.
+  size_t ReadCompressed(uint8_t* buf, size_t buf_size) {
+    size_t size = 0;
+    while (size < buf_size && pos_ < info_.size) {
+      if (block_pos_ < block_end_) {
+        size_t copy = std::min(buf_size - size, block_end_ - block_pos_);
+        memcpy(buf + size, block_.get() + block_pos_, copy);
+        block_pos_ += copy;
+        size += copy;
+        pos_ += copy;
+        continue;
+      }
+
+      size_t block_size = MappedAsarArchive::GetBlockSize(info_, next_block_);
+      bool direct = buf_size - size >= block_size;
+      if (!direct && !block_)
+        block_.reset(new uint8_t[info_.block_size]);
+      uint8_t* out = direct ? buf + size : block_.get();
+      if (!archive_->ReadBlock(info_, next_block_, out))
+        break;
+      ++next_block_;
+      if (direct) {
+        size += block_size;
+        pos_ += block_size;
+      } else {
+        block_pos_ = 0;
+        block_end_ = block_size;
+      }
+    }
+    return size;
+  }
+
+  base::FilePath asar_;
+  std::string path_in_archive_;
+
+  scoped_refptr<MappedAsarArchive> archive_;
+  MappedAsarArchive::FileInfo info_;
+  uint64_t plain_size_ = 0;
+  uint64_t pos_ = 0;
+
+  std::unique_ptr<AESCBCDecryptor> decryptor_;
+  std::string key_;
+  std::string iv_;
+  uint64_t cipher_pos_ = 0;
+  uint8_t pending_[AES_BLOCKLEN];
+  size_t pending_pos_ = 0;
+  size_t pending_end_ = 0;
+
+  size_t next_block_ = 0;
+  std::unique_ptr<uint8_t[]> block_;
+  size_t block_pos_ = 0;
+  size_t block_end_ = 0;
+
+ private:
+  DISALLOW_COPY_AND_ASSIGN(ProtocolMappedAsarJob);
+};
+
+}  // namespace nu
+
+#endif  // NATIVEUI_PROTOCOL_MAPPED_ASAR_JOB_H_
@@ -0,0 +1,75 @@
+// Copyright 2018 Cheng Zhao. All rights reserved.
+// Use of this source code is governed by the license that can be found in the
+// LICENSE file.
+
+#ifndef NATIVEUI_PROTOCOL_MAPPED_FILE_JOB_H_
+#define NATIVEUI_PROTOCOL_MAPPED_FILE_JOB_H_
+
+#include <string.h>
+
+#include <algorithm>
+
+#include "nativeui/protocol_seekable_file_job.h"
+#include "nativeui/util/ref_counted_mapped_file.h"
+
+namespace nu {
+
+// Serve a file by mapping it into memory, so its content can be handed out
+// with GetDirectBuffer() instead of being copied chunk by chunk.
+class ProtocolMappedFileJob : public ProtocolSeekableFileJob {
+ public:
+  explicit ProtocolMappedFileJob(const base::FilePath& path)
+      : ProtocolSeekableFileJob(path) {}
+
+  // ProtocolJob:
+  bool Start() override {
+    auto mapping = base::MakeRefCounted<RefCountedMappedFile>();
+    if (!mapping->Initialize(path_))
+      return false;
+    mapping_ = std::move(mapping);
+    content_length_ = mapping_->size();
+    notify_content_length(static_cast<int>(content_length_));
+    return true;
+  }
+
+  void Kill() override {
+    ProtocolFileJob::Kill();
+    mapping_ = nullptr;
+  }
+
+  size_t Read(void* buf, size_t buf_size) override {
+    if (!mapping_)
+      return 0;
+    size_t size = std::min(buf_size, mapping_->size() - pos_);
+    memcpy(buf, mapping_->front() + pos_, size);
+    pos_ += size;
+    return size;
+  }
+
+  // ProtocolSeekableFileJob:
+  bool Seek(uint64_t offset) override {
+    if (!mapping_ || offset > mapping_->size())
+      return false;
+    pos_ = static_cast<size_t>(offset);
+    return true;
+  }
+
+  // Return the file's content without copying it. Can be used instead of
+  // Read() after Start() succeeded.
+  scoped_refptr<base::RefCountedMemory> GetDirectBuffer() const {
+    return mapping_;
+  }
+
+ protected:
+  ~ProtocolMappedFileJob() override = default;
+
+  scoped_refptr<RefCountedMappedFile> mapping_;
+  size_t pos_ = 0;
+
+ private:
+  DISALLOW_COPY_AND_ASSIGN(ProtocolMappedFileJob);
+};
+
+}  // namespace nu
+
+#endif  // NATIVEUI_PROTOCOL_MAPPED_FILE_JOB_H_
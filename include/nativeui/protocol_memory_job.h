@@ -0,0 +1,63 @@
+// Copyright 2018 Cheng Zhao. All rights reserved.
+// Use of this source code is governed by the license that can be found in the
+// LICENSE file.
+
+#ifndef NATIVEUI_PROTOCOL_MEMORY_JOB_H_
+#define NATIVEUI_PROTOCOL_MEMORY_JOB_H_
+
+#include <string.h>
+
+#include <algorithm>
+#include <string>
+#include <utility>
+
+#include "base/memory/ref_counted_memory.h"
+#include "nativeui/protocol_job.h"
+
+namespace nu {
+
+// Like ProtocolStringJob, but serving a shared buffer instead of its own copy
+// of the content.
+class ProtocolMemoryJob : public ProtocolJob {
+ public:
+  ProtocolMemoryJob(const std::string& mime_type,
+                    scoped_refptr<base::RefCountedMemory> content)
+      : mime_type_(mime_type), content_(std::move(content)) {}
+
+  // ProtocolJob:
+  bool Start() override {
+    notify_content_length(static_cast<int>(content_->size()));
+    return true;
+  }
+
+  bool GetMimeType(std::string* mime_type) override {
+    *mime_type = mime_type_;
+    return true;
+  }
+
+  size_t Read(void* buf, size_t buf_size) override {
+    size_t size = std::min(buf_size, content_->size() - pos_);
+    memcpy(buf, content_->front() + pos_, size);
+    pos_ += size;
+    return size;
+  }
+
+  // Return the content without copying it.
+  scoped_refptr<base::RefCountedMemory> GetDirectBuffer() const {
+    return content_;
+  }
+
+ protected:
+  ~ProtocolMemoryJob() override = default;
+
+ private:
+  std::string mime_type_;
+  scoped_refptr<base::RefCountedMemory> content_;
+  size_t pos_ = 0;
+
+  DISALLOW_COPY_AND_ASSIGN(ProtocolMemoryJob);
+};
+
+}  // namespace nu
+
+#endif  // NATIVEUI_PROTOCOL_MEMORY_JOB_H_
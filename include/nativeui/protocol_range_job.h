@@ -0,0 +1,147 @@
+// Copyright 2018 Cheng Zhao. All rights reserved.
+// Use of this source code is governed by the license that can be found in the
+// LICENSE file.
+
+#ifndef NATIVEUI_PROTOCOL_RANGE_JOB_H_
+#define NATIVEUI_PROTOCOL_RANGE_JOB_H_
+
+#include <stdint.h>
+
+#include <algorithm>
+#include <string>
+#include <utility>
+
+#include "base/strings/string_number_conversions.h"
+#include "base/strings/string_piece.h"
+#include "nativeui/protocol_seekable_file_job.h"
+
+namespace nu {
+
+// Serve the part of a seekable job asked for by the Range header of a
+// request, with the semantics of HTTP:
+//
+//   * 206: the range is served, and content_range() is the Content-Range
+//     header;
+//   * 416: the range starts past the end of the content, and Start() fails;
+//   * 200: there is no range, or it is malformed or has several parts, and
+//     the whole content is served.
+//
+// Only the range is read from the job, which seeks to its start.
+//
+// Browser::RegisterProtocol() can neither read request headers nor send a
+// status, so on GTK the job is used through
+// ProtocolSchemeRequest::FinishWithRange().
+class ProtocolRangeJob : public ProtocolJob {
+ public:
+  // |range| is the value of the Range header, e.g. "bytes=1000-1999".
+  ProtocolRangeJob(scoped_refptr<ProtocolSeekableFileJob> job,
+                   const std::string& range)
+      : job_(std::move(job)), range_(range) {}
+
+  // Parse the value of a Range header for content of |length| bytes. Returns
+  // the status code, and the first and last bytes of the range for 206.
+  static int ParseRange(base::StringPiece range,
+                        uint64_t length,
+                        uint64_t* first,
+                        uint64_t* last) {
+    const base::StringPiece kPrefix("bytes=");
+    if (!range.starts_with(kPrefix))
+      return 200;
+    range.remove_prefix(kPrefix.size());
+    size_t dash = range.find('-');
+    if (dash == base::StringPiece::npos ||
+        range.find(',') != base::StringPiece::npos)
+      return 200;
+    base::StringPiece begin = range.substr(0, dash);
+    base::StringPiece end = range.substr(dash + 1);
+
+    uint64_t value;
+    if (begin.empty()) {
+      // "bytes=-500" is the last 500 bytes.
+      if (!base::StringToUint64(end, &value))
+        return 200;
+      if (value == 0 || length == 0)
+        return 416;
+      *first = length - std::min(value, length);
+      *last = length - 1;
+      return 206;
+    }
+
+    if (!base::StringToUint64(begin, first))
+      return 200;
+    *last = length - 1;
+    if (!end.empty()) {
+      if (!base::StringToUint64(end, &value) || value < *first)
+        return 200;
+      *last = std::min(value, *last);
+    }
+    return *first < length ? 206 : 416;
+  }
+
+  // ProtocolJob:
+  bool Start() override {
+    job_->Plug([](int) {});
+    if (!job_->Start())
+      return false;
+    uint64_t length = job_->content_length();
+    status_code_ = ParseRange(range_, length, &first_, &last_);
+    if (status_code_ == 416) {
+      content_range_ = "bytes */" + base::NumberToString(length);
+      return false;
+    }
+    if (status_code_ == 206) {
+      if (!job_->Seek(first_))
+        return false;
+      content_range_ = "bytes " + base::NumberToString(first_) + "-" +
+                       base::NumberToString(last_) + "/" +
+                       base::NumberToString(length);
+      remaining_ = last_ - first_ + 1;
+    } else {
+      remaining_ = length;
+    }
+    range_length_ = remaining_;
+    notify_content_length(static_cast<int>(remaining_));
+    return true;
+  }
+
+  void Kill() override {
+    job_->Kill();
+    ProtocolJob::Kill();
+  }
+
+  bool GetMimeType(std::string* mime_type) override {
+    return job_->GetMimeType(mime_type);
+  }
+
+  size_t Read(void* buf, size_t buf_size) override {
+    size_t size = job_->Read(
+        buf, static_cast<size_t>(std::min<uint64_t>(buf_size, remaining_)));
+    remaining_ -= size;
+    return size;
+  }
+
+  // Available after Start() was called.
+  int status_code() const { return status_code_; }
+  const std::string& content_range() const { return content_range_; }
+  uint64_t range_length() const { return range_length_; }
+
+ protected:
+  ~ProtocolRangeJob() override = default;
+
+ private:
+  scoped_refptr<ProtocolSeekableFileJob> job_;
+  std::string range_;
+
+  int status_code_ = 200;
+  std::string content_range_;
+  uint64_t first_ = 0;
+  uint64_t last_ = 0;
+  uint64_t range_length_ = 0;
+  uint64_t remaining_ = 0;
+
+  DISALLOW_COPY_AND_ASSIGN(ProtocolRangeJob);
+};
+
+}  // namespace nu
+
+#endif  // NATIVEUI_PROTOCOL_RANGE_JOB_H_
@@ -0,0 +1,236 @@
+// Copyright 2018 Cheng Zhao. All rights reserved.
+// Use of this source code is governed by the license that can be found in the
+// LICENSE file.
+
+#ifndef NATIVEUI_PROTOCOL_RESPONSE_CACHE_H_
+#define NATIVEUI_PROTOCOL_RESPONSE_CACHE_H_
+
+#include <functional>
+#include <string>
+#include <utility>
+
+#include "base/containers/mru_cache.h"
+#include "base/files/file.h"
+#include "base/files/file_path.h"
+#include "base/files/file_util.h"
+#include "base/memory/ref_counted.h"
+#include "base/memory/ref_counted_memory.h"
+#include "base/synchronization/lock.h"
+#include "base/time/time.h"
+#include "nativeui/protocol_memory_job.h"
+
+namespace nu {
+
+class ProtocolResponseCache;
+
+namespace internal {
+
+// Pass through the content of another job, and put it in the cache once it
+// has been read to the end.
+class ProtocolCachingJob : public ProtocolJob {
+ public:
+  ProtocolCachingJob(ProtocolJob* job,
+                     scoped_refptr<ProtocolResponseCache> cache,
+                     const std::string& url,
+                     base::Time last_modified)
+      : job_(job),
+        cache_(std::move(cache)),
+        url_(url),
+        last_modified_(last_modified) {}
+
+  // ProtocolJob:
+  inline bool Start() override;
+
+  void Kill() override {
+    caching_ = false;
+    job_->Kill();
+    ProtocolJob::Kill();
+  }
+
+  bool GetMimeType(std::string* mime_type) override {
+    return job_->GetMimeType(mime_type);
+  }
+
+  inline size_t Read(void* buf, size_t buf_size) override;
+
+ protected:
+  ~ProtocolCachingJob() override = default;
+
+ private:
+  scoped_refptr<ProtocolJob> job_;
+  scoped_refptr<ProtocolResponseCache> cache_;
+  std::string url_;
+  base::Time last_modified_;
+
+  int length_ = -1;
+  bool caching_ = true;
+  std::string body_;
+
+  DISALLOW_COPY_AND_ASSIGN(ProtocolCachingJob);
+};
+
+}  // namespace internal
+
+// An LRU cache of the responses of protocol handlers, keyed by URL and
+// limited by the total size of the bodies.
+//
+// Hits are served by a ProtocolMemoryJob sharing the cached body, without
+// calling the handler. A response is cached once its job has been read to
+// the end. When a URL is served from a file, the file's modification time is
+// checked on every hit, and a changed file is served again by the handler.
+//
+// Handlers may run on any thread, e.g. when wrapped by ProtocolAsyncJob; the
+// cache is guarded by a lock.
+class ProtocolResponseCache
+    : public base::RefCountedThreadSafe<ProtocolResponseCache> {
+ public:
+  using Handler = std::function<ProtocolJob*(const std::string&)>;
+
+  // Return the file a URL is served from, e.g. the file or the asar archive,
+  // or an empty path if its responses do not need to be validated.
+  using SourceResolver = std::function<base::FilePath(const std::string&)>;
+
+  explicit ProtocolResponseCache(size_t max_bytes)
+      : entries_(Entries::NO_AUTO_EVICT), max_bytes_(max_bytes) {}
+
+  // Return a handler for Browser::RegisterProtocol() serving cached
+  // responses, and calling |handler| on misses.
+  Handler Wrap(Handler handler, SourceResolver resolver = SourceResolver()) {
+    scoped_refptr<ProtocolResponseCache> self(this);
+    return [self, handler, resolver](const std::string& url) -> ProtocolJob* {
+      base::Time last_modified;
+      if (resolver) {
+        base::FilePath path = resolver(url);
+        base::File::Info info;
+        if (!path.empty() && base::GetFileInfo(path, &info))
+          last_modified = info.last_modified;
+      }
+      ProtocolJob* hit = self->Lookup(url, last_modified);
+      if (hit)
+        return hit;
+      ProtocolJob* job = handler(url);
+      if (!job)
+        return nullptr;
+      return new internal::ProtocolCachingJob(job, self, url, last_modified);
+    };
+  }
+
+  // Return a job serving the cached response for |url|, unless there is none
+  // or it was cached for another |last_modified| time.
+  ProtocolJob* Lookup(const std::string& url, base::Time last_modified) {
+    base::AutoLock auto_lock(lock_);
+    auto it = entries_.Get(url);
+    if (it == entries_.end())
+      return nullptr;
+    if (it->second.last_modified != last_modified) {
+      total_bytes_ -= it->second.body->size();
+      entries_.Erase(it);
+      return nullptr;
+    }
+    return new ProtocolMemoryJob(it->second.mime_type, it->second.body);
+  }
+
+  // Cache a response, evicting the least recently used ones to stay within
+  // the budget. Responses larger than the whole budget are not cached.
+  void Put(const std::string& url,
+           const std::string& mime_type,
+           scoped_refptr<base::RefCountedMemory> body,
+           base::Time last_modified) {
+    size_t size = body->size();
+    if (size > max_bytes_)
+      return;
+    base::AutoLock auto_lock(lock_);
+    auto it = entries_.Peek(url);
+    if (it != entries_.end()) {
+      total_bytes_ -= it->second.body->size();
+      entries_.Erase(it);
+    }
+    entries_.Put(url, Entry{mime_type, std::move(body), last_modified});
+    total_bytes_ += size;
+    while (total_bytes_ > max_bytes_) {
+      auto last = entries_.rbegin();
+      total_bytes_ -= last->second.body->size();
+      entries_.Erase(last);
+    }
+  }
+
+  void Clear() {
+    base::AutoLock auto_lock(lock_);
+    entries_.Clear();
+    total_bytes_ = 0;
+  }
+
+  size_t max_bytes() const { return max_bytes_; }
+
+  size_t total_bytes() const {
+    base::AutoLock auto_lock(lock_);
+    return total_bytes_;
+  }
+
+  size_t entry_count() const {
+    base::AutoLock auto_lock(lock_);
+    return entries_.size();
+  }
+
+ private:
+  friend class base::RefCountedThreadSafe<ProtocolResponseCache>;
+
+  struct Entry {
+    std::string mime_type;
+    scoped_refptr<base::RefCountedMemory> body;
+    base::Time last_modified;
+  };
+
+  using Entries = base::HashingMRUCache<std::string, Entry>;
+
+  ~ProtocolResponseCache() = default;
+
+  mutable base::Lock lock_;
+  Entries entries_;
+  const size_t max_bytes_;
+  size_t total_bytes_ = 0;
+
+  DISALLOW_COPY_AND_ASSIGN(ProtocolResponseCache);
+};
+
+namespace internal {
+
+bool ProtocolCachingJob::Start() {
+  job_->Plug([this](int length) {
+    length_ = length;
+    if (length > 0 && static_cast<size_t>(length) <= cache_->max_bytes())
+      body_.reserve(length);
+    notify_content_length(length);
+  });
+  return job_->Start();
+}
+
+size_t ProtocolCachingJob::Read(void* buf, size_t buf_size) {
+  size_t size = job_->Read(buf, buf_size);
+  if (!caching_)
+    return size;
+  if (size > 0) {
+    if (body_.size() + size > cache_->max_bytes()) {
+      caching_ = false;
+      std::string().swap(body_);
+    } else {
+      body_.append(static_cast<const char*>(buf), size);
+    }
+    return size;
+  }
+
+  // Only complete responses are cached.
+  caching_ = false;
+  std::string mime_type;
+  if ((length_ < 0 || body_.size() == static_cast<size_t>(length_)) &&
+      job_->GetMimeType(&mime_type))
+    cache_->Put(url_, mime_type, base::RefCountedString::TakeString(&body_),
+                last_modified_);
+  return 0;
+}
+
+}  // namespace internal
+
+}  // namespace nu
+
+#endif  // NATIVEUI_PROTOCOL_RESPONSE_CACHE_H_
@@ -0,0 +1,41 @@
+// Copyright 2018 Cheng Zhao. All rights reserved.
+// Use of this source code is governed by the license that can be found in the
+// LICENSE file.
+
+#ifndef NATIVEUI_PROTOCOL_SEEKABLE_FILE_JOB_H_
+#define NATIVEUI_PROTOCOL_SEEKABLE_FILE_JOB_H_
+
+#include <stdint.h>
+
+#include "nativeui/protocol_file_job.h"
+
+namespace nu {
+
+// A file job that can read from any position of its content, so media and
+// other range requests do not have to stream everything before the range.
+class ProtocolSeekableFileJob : public ProtocolFileJob {
+ public:
+  // Move the position of the next Read() to |offset|, which can not be past
+  // content_length(). Can only be called after Start() succeeded.
+  virtual bool Seek(uint64_t offset) = 0;
+
+  // Read from |offset|; the following reads continue from there.
+  size_t ReadRange(uint64_t offset, void* buf, size_t buf_size) {
+    return Seek(offset) ? Read(buf, buf_size) : 0;
+  }
+
+  // Length of the whole content, known once Start() succeeded.
+  uint64_t content_length() const { return content_length_; }
+
+ protected:
+  explicit ProtocolSeekableFileJob(const base::FilePath& path)
+      : ProtocolFileJob(path) {}
+  ~ProtocolSeekableFileJob() override = default;
+
+ private:
+  DISALLOW_COPY_AND_ASSIGN(ProtocolSeekableFileJob);
+};
+
+}  // namespace nu
+
+#endif  // NATIVEUI_PROTOCOL_SEEKABLE_FILE_JOB_H_
@@ -0,0 +1,147 @@
+// Copyright 2018 Cheng Zhao. All rights reserved.
+// Use of this source code is governed by the license that can be found in the
+// LICENSE file.
+
+#ifndef NATIVEUI_SCRIPT_QUEUE_H_
+#define NATIVEUI_SCRIPT_QUEUE_H_
+
+#include <functional>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "base/json/string_escape.h"
+#include "base/memory/weak_ptr.h"
+#include "nativeui/browser.h"
+#include "nativeui/message_loop.h"
+
+namespace nu {
+
+// Coalesce scripts posted to a browser into one ExecuteJavaScript() call per
+// frame, e.g. to stream updates of many objects to a page at 60Hz.
+//
+// A script posted with a key replaces the script with the same key that is
+// still waiting, so only the latest update of an object is evaluated. While
+// an evaluation is in flight no other one is started; the scripts posted
+// meanwhile go out together once it returns.
+//
+// Scripts are evaluated in the global scope in the order they were first
+// posted. Their results are delivered together as one list, with null for
+// scripts that threw or returned undefined.
+//
+// Must be used on the GUI thread.
+class ScriptQueue {
+ public:
+  using ResultsCallback = std::function<void(bool success,
+                                             base::Value results)>;
+
+  static constexpr int kFrameIntervalMs = 16;
+
+  explicit ScriptQueue(Browser* browser,
+                       int interval_ms = kFrameIntervalMs)
+      : browser_(browser), interval_ms_(interval_ms), weak_factory_(this) {}
+
+  ~ScriptQueue() = default;
+
+  // Receive the results of each evaluation.
+  void SetResultsCallback(const ResultsCallback& callback) {
+    on_results_ = callback;
+  }
+
+  void Post(const std::string& code) {
+    scripts_.push_back(code);
+    Schedule();
+  }
+
+  // Post |code| in place of the waiting script posted with |key|, if any.
+  void Post(const std::string& key, const std::string& code) {
+    auto it = keyed_.find(key);
+    if (it != keyed_.end()) {
+      scripts_[it->second] = code;
+      return;
+    }
+    keyed_.emplace(key, scripts_.size());
+    scripts_.push_back(code);
+    Schedule();
+  }
+
+  // Evaluate the waiting scripts now, unless an evaluation is in flight.
+  void Flush() {
+    scheduled_.Cancel();
+    if (evaluating_ || scripts_.empty())
+      return;
+    evaluating_ = true;
+    std::vector<std::string> scripts;
+    scripts.swap(scripts_);
+    keyed_.clear();
+    base::WeakPtr<ScriptQueue> weak = weak_factory_.GetWeakPtr();
+    browser_->ExecuteJavaScript(
+        GetBatchScript(scripts),
+        [weak](bool success, base::Value results) {
+          if (weak)
+            weak->OnEvaluated(success, std::move(results));
+        });
+  }
+
+  // Number of scripts waiting for the next evaluation.
+  size_t pending_count() const { return scripts_.size(); }
+  bool is_evaluating() const { return evaluating_; }
+
+ private:
+  // Each script goes through an indirect eval, which runs it in the global
+  // scope and returns its completion value like ExecuteJavaScript() does.
+  static std::string GetBatchScript(const std::vector<std::string>& scripts) {
+    std::string list;
+    for (const std::string& code : scripts) {
+      if (!list.empty())
+        list += ',';
+      base::EscapeJSONString(code, true, &list);
+    }
+    return "(function(s) {\n"
+           "  var r = [];\n"
+           "  for (var i = 0; i < s.length; ++i) {\n"
+           "    try {\n"
+           "      var v = (0, eval)(s[i]);\n"
+           "      r.push(v === undefined ? null : v);\n"
+           "    } catch (e) {\n"
+           "      r.push(null);\n"
+           "    }\n"
+           "  }\n"
+           "  return r;\n"
+           "})([" + list + "])";
+  }
+
+  void Schedule() {
+    if (scheduled_.IsPending() || evaluating_)
+      return;
+    scheduled_ = MessageLoop::PostDelayedTask(
+        interval_ms_,
+        base::BindOnce(&ScriptQueue::Flush, weak_factory_.GetWeakPtr()));
+  }
+
+  void OnEvaluated(bool success, base::Value results) {
+    evaluating_ = false;
+    if (on_results_)
+      on_results_(success, std::move(results));
+    if (!scripts_.empty())
+      Schedule();
+  }
+
+  scoped_refptr<Browser> browser_;
+  const int interval_ms_;
+  ResultsCallback on_results_;
+
+  std::vector<std::string> scripts_;
+  std::unordered_map<std::string, size_t> keyed_;  // Key => index in scripts_
+  MessageLoop::DelayedTaskHandle scheduled_;
+  bool evaluating_ = false;
+
+  base::WeakPtrFactory<ScriptQueue> weak_factory_;
+
+  DISALLOW_COPY_AND_ASSIGN(ScriptQueue);
+};
+
+}  // namespace nu
+
+#endif  // NATIVEUI_SCRIPT_QUEUE_H_
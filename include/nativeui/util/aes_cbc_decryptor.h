@@ -0,0 +1,189 @@
+// Copyright 2018 Cheng Zhao. All rights reserved.
+// Use of this source code is governed by the license that can be found in the
+// LICENSE file.
+
+#ifndef NATIVEUI_UTIL_AES_CBC_DECRYPTOR_H_
+#define NATIVEUI_UTIL_AES_CBC_DECRYPTOR_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#include <string>
+
+#include "base/cpu.h"
+#include "base/logging.h"
+#include "base/macros.h"
+#include "build/build_config.h"
+#include "nativeui/util/aes.h"
+
+#if defined(ARCH_CPU_X86_FAMILY)
+#include <wmmintrin.h>
+#include <emmintrin.h>
+#endif
+
+#if defined(ARCH_CPU_X86_FAMILY) && (defined(COMPILER_GCC) || defined(__clang__))
+#define NU_TARGET_AESNI __attribute__((target("aes,sse2")))
+#else
+#define NU_TARGET_AESNI
+#endif
+
+namespace nu {
+
+// AES-128-CBC decryption with the same key, IV and chaining semantics as
+// AES::CBCDecryptBuffer().
+//
+// On x86 CPUs with AES-NI, blocks are decrypted with the AES instructions,
+// several at a time: unlike encryption, every block of CBC decryption only
+// depends on ciphertext, so the pipelined instructions of consecutive blocks
+// overlap. Elsewhere it falls back to the portable AES.
+class AESCBCDecryptor {
+ public:
+  // |use_aesni| can be set to false to force the portable code, for tests and
+  // benchmarks.
+  explicit AESCBCDecryptor(bool use_aesni = true)
+      : use_aesni_(use_aesni && HasAESNI()) {}
+
+  bool Init(const std::string& key, const std::string& iv) {
+    if (!fallback_.Init(key, iv))
+      return false;
+#if defined(ARCH_CPU_X86_FAMILY)
+    if (use_aesni_)
+      ExpandKey(reinterpret_cast<const uint8_t*>(key.data()),
+                reinterpret_cast<const uint8_t*>(iv.data()));
+#endif
+    return true;
+  }
+
+  bool IsValid() const { return fallback_.IsValid(); }
+  bool uses_aesni() const { return use_aesni_; }
+
+  // Decrypt |buf| in place. |len| must be a multiple of AES_BLOCKLEN; the
+  // chain continues from the previous call.
+  void DecryptBuffer(uint8_t* buf, size_t len) {
+    DCHECK(IsValid());
+    DCHECK_EQ(len % AES_BLOCKLEN, 0u);
+#if defined(ARCH_CPU_X86_FAMILY)
+    if (use_aesni_) {
+      DecryptAESNI(buf, len / AES_BLOCKLEN);
+      return;
+    }
+#endif
+    fallback_.CBCDecryptBuffer(buf, static_cast<uint32_t>(len));
+  }
+
+ private:
+  static bool HasAESNI() {
+#if defined(ARCH_CPU_X86_FAMILY)
+    static const bool has_aesni = base::CPU().has_aesni();
+    return has_aesni;
+#else
+    return false;
+#endif
+  }
+
+#if defined(ARCH_CPU_X86_FAMILY)
+  static constexpr int kRounds = 10;
+
+  // Number of blocks decrypted together, enough to hide the latency of the
+  // AESDEC instruction.
+  static constexpr size_t kParallelBlocks = 8;
+
+  NU_TARGET_AESNI static __m128i ExpandStep(__m128i key, __m128i assist) {
+    assist = _mm_shuffle_epi32(assist, _MM_SHUFFLE(3, 3, 3, 3));
+    key = _mm_xor_si128(key, _mm_slli_si128(key, 4));
+    key = _mm_xor_si128(key, _mm_slli_si128(key, 4));
+    key = _mm_xor_si128(key, _mm_slli_si128(key, 4));
+    return _mm_xor_si128(key, assist);
+  }
+
+  NU_TARGET_AESNI void ExpandKey(const uint8_t* key, const uint8_t* iv) {
+    __m128i enc[kRounds + 1];
+    enc[0] = _mm_loadu_si128(reinterpret_cast<const __m128i*>(key));
+    // _mm_aeskeygenassist_si128 needs the round constant as an immediate.
+#define NU_AES_EXPAND(i, rcon) \
+    enc[i] = ExpandStep(enc[i - 1], _mm_aeskeygenassist_si128(enc[i - 1], rcon))
+    NU_AES_EXPAND(1, 0x01);
+    NU_AES_EXPAND(2, 0x02);
+    NU_AES_EXPAND(3, 0x04);
+    NU_AES_EXPAND(4, 0x08);
+    NU_AES_EXPAND(5, 0x10);
+    NU_AES_EXPAND(6, 0x20);
+    NU_AES_EXPAND(7, 0x40);
+    NU_AES_EXPAND(8, 0x80);
+    NU_AES_EXPAND(9, 0x1b);
+    NU_AES_EXPAND(10, 0x36);
+#undef NU_AES_EXPAND
+
+    // The equivalent inverse cipher uses the round keys in reverse order,
+    // with InvMixColumns applied to the inner ones.
+    Store(dec_keys_[0], enc[kRounds]);
+    for (int i = 1; i < kRounds; ++i)
+      Store(dec_keys_[i], _mm_aesimc_si128(enc[kRounds - i]));
+    Store(dec_keys_[kRounds], enc[0]);
+    memcpy(iv_, iv, AES_BLOCKLEN);
+  }
+
+  NU_TARGET_AESNI void DecryptAESNI(uint8_t* buf, size_t blocks) {
+    __m128i keys[kRounds + 1];
+    for (int i = 0; i <= kRounds; ++i)
+      keys[i] = Load(dec_keys_[i]);
+    __m128i prev = Load(iv_);
+    __m128i* data = reinterpret_cast<__m128i*>(buf);
+
+    size_t i = 0;
+    for (; i + kParallelBlocks <= blocks; i += kParallelBlocks) {
+      __m128i cipher[kParallelBlocks];
+      __m128i state[kParallelBlocks];
+      for (size_t j = 0; j < kParallelBlocks; ++j) {
+        cipher[j] = _mm_loadu_si128(data + i + j);
+        state[j] = _mm_xor_si128(cipher[j], keys[0]);
+      }
+      for (int r = 1; r < kRounds; ++r) {
+        for (size_t j = 0; j < kParallelBlocks; ++j)
+          state[j] = _mm_aesdec_si128(state[j], keys[r]);
+      }
+      for (size_t j = 0; j < kParallelBlocks; ++j) {
+        state[j] = _mm_aesdeclast_si128(state[j], keys[kRounds]);
+        state[j] = _mm_xor_si128(state[j], j == 0 ? prev : cipher[j - 1]);
+        _mm_storeu_si128(data + i + j, state[j]);
+      }
+      prev = cipher[kParallelBlocks - 1];
+    }
+
+    for (; i < blocks; ++i) {
+      __m128i cipher = _mm_loadu_si128(data + i);
+      __m128i state = _mm_xor_si128(cipher, keys[0]);
+      for (int r = 1; r < kRounds; ++r)
+        state = _mm_aesdec_si128(state, keys[r]);
+      state = _mm_aesdeclast_si128(state, keys[kRounds]);
+      _mm_storeu_si128(data + i, _mm_xor_si128(state, prev));
+      prev = cipher;
+    }
+    Store(iv_, prev);
+  }
+
+  NU_TARGET_AESNI static __m128i Load(const uint8_t* block) {
+    return _mm_loadu_si128(reinterpret_cast<const __m128i*>(block));
+  }
+
+  NU_TARGET_AESNI static void Store(uint8_t* block, __m128i value) {
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(block), value);
+  }
+
+  // Kept as bytes, since heap allocations may not be aligned for __m128i.
+  uint8_t dec_keys_[kRounds + 1][AES_BLOCKLEN];
+  uint8_t iv_[AES_BLOCKLEN];
+#endif
+
+  bool use_aesni_;
+  AES fallback_;
+
+  DISALLOW_COPY_AND_ASSIGN(AESCBCDecryptor);
+};
+
+}  // namespace nu
+
+#undef NU_TARGET_AESNI
+
+#endif  // NATIVEUI_UTIL_AES_CBC_DECRYPTOR_H_
@@ -0,0 +1,76 @@
+// Copyright 2018 Cheng Zhao. All rights reserved.
+// Use of this source code is governed by the license that can be found in the
+// LICENSE file.
+
+#ifndef NATIVEUI_UTIL_BINARY_DATA_H_
+#define NATIVEUI_UTIL_BINARY_DATA_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <string>
+#include <type_traits>
+#include <utility>
+
+#include "base/base64.h"
+#include "base/containers/span.h"
+#include "base/logging.h"
+#include "base/macros.h"
+#include "base/values.h"
+
+namespace nu {
+
+// The bytes of an ArrayBuffer or typed array passed to a native binding.
+//
+// Web pages send them as {"$nuBinary": "<base64>"}, which is decoded once
+// into this buffer, instead of as a list of numbers that would be turned into
+// a base::Value each.
+class BinaryData {
+ public:
+  // Key of the object wrapping binary data in binding arguments.
+  static constexpr const char* kKey = "$nuBinary";
+
+  BinaryData() = default;
+  BinaryData(BinaryData&&) = default;
+  BinaryData& operator=(BinaryData&&) = default;
+
+  // Take the content of |value| if it is binary data: either a BINARY value
+  // or a wrapped base64 string. Returns false otherwise.
+  bool Take(base::Value* value) {
+    if (value->is_blob()) {
+      const base::Value::BlobStorage& blob = value->GetBlob();
+      data_.assign(blob.data(), blob.size());
+      return true;
+    }
+    if (!value->is_dict())
+      return false;
+    const base::Value* encoded =
+        value->FindKeyOfType(kKey, base::Value::Type::STRING);
+    return encoded && base::Base64Decode(encoded->GetString(), &data_);
+  }
+
+  // View the bytes as an array of |T|, e.g. the floats of a Float32Array.
+  // Trailing bytes that do not make a whole element are ignored.
+  template<typename T>
+  base::span<const T> As() const {
+    static_assert(std::is_arithmetic<T>::value, "T must be arithmetic");
+    DCHECK_EQ(reinterpret_cast<uintptr_t>(data_.data()) % alignof(T), 0u);
+    return base::span<const T>(reinterpret_cast<const T*>(data_.data()),
+                               data_.size() / sizeof(T));
+  }
+
+  base::span<const uint8_t> bytes() const { return As<uint8_t>(); }
+
+  const char* data() const { return data_.data(); }
+  size_t size() const { return data_.size(); }
+  bool empty() const { return data_.empty(); }
+
+ private:
+  std::string data_;
+
+  DISALLOW_COPY_AND_ASSIGN(BinaryData);
+};
+
+}  // namespace nu
+
+#endif  // NATIVEUI_UTIL_BINARY_DATA_H_
@@ -10,6 +10,7 @@
 #include <utility>
 
 #include "base/values.h"
+#include "nativeui/util/binary_data.h"
 
 namespace nu {
 
@@ -77,6 +78,12 @@ inline void GetArgument(CallContext* context, base::Value* arg,
   context->current_arg++;
 }
 
+inline void GetArgument(CallContext* context, base::Value* arg,
+                        BinaryData* value) {
+  value->Take(arg);
+  context->current_arg++;
+}
+
 inline void GetArgument(CallContext* context, base::Value* arg, bool* value) {
   if (arg->is_bool())
     *value = arg->GetBool();
@@ -0,0 +1,89 @@
+// Copyright 2018 Cheng Zhao. All rights reserved.
+// Use of this source code is governed by the license that can be found in the
+// LICENSE file.
+
+#ifndef NATIVEUI_UTIL_LZ4_BLOCK_H_
+#define NATIVEUI_UTIL_LZ4_BLOCK_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+namespace nu {
+
+// Decompress one block in the LZ4 block format, as written by LZ4_compress()
+// or by the lz4 tool for each block of a frame.
+//
+// Returns false unless |src| decompresses to exactly |dst_size| bytes. Every
+// read and write is bounds checked, so corrupted input can not overrun
+// either buffer.
+inline bool LZ4DecompressBlock(const uint8_t* src, size_t src_size,
+                               uint8_t* dst, size_t dst_size) {
+  const uint8_t* ip = src;
+  const uint8_t* const src_end = src + src_size;
+  uint8_t* op = dst;
+  uint8_t* const dst_end = dst + dst_size;
+
+  // Lengths of 15 continue with bytes that are added up until one is not
+  // 255.
+  auto read_length = [&ip, src_end](size_t* length) {
+    if (*length != 15)
+      return true;
+    uint8_t byte;
+    do {
+      if (ip == src_end)
+        return false;
+      byte = *ip++;
+      *length += byte;
+    } while (byte == 255);
+    return true;
+  };
+
+  while (ip < src_end) {
+    uint8_t token = *ip++;
+
+    size_t literals = token >> 4;
+    if (!read_length(&literals) ||
+        literals > static_cast<size_t>(src_end - ip) ||
+        literals > static_cast<size_t>(dst_end - op))
+      return false;
+    memcpy(op, ip, literals);
+    ip += literals;
+    op += literals;
+
+    // The last sequence only has literals.
+    if (ip == src_end)
+      break;
+
+    if (src_end - ip < 2)
+      return false;
+    size_t offset = ip[0] | (ip[1] << 8);
+    ip += 2;
+    if (offset == 0 || offset > static_cast<size_t>(op - dst))
+      return false;
+
+    size_t match = token & 15;
+    if (!read_length(&match))
+      return false;
+    match += 4;
+    if (match > static_cast<size_t>(dst_end - op))
+      return false;
+
+    // Matches may overlap their own output, so copy forward byte by byte
+    // unless they are far enough behind.
+    const uint8_t* from = op - offset;
+    if (offset >= match) {
+      memcpy(op, from, match);
+      op += match;
+    } else {
+      for (size_t i = 0; i < match; ++i)
+        *op++ = *from++;
+    }
+  }
+
+  return op == dst_end;
+}
+
+}  // namespace nu
+
+#endif  // NATIVEUI_UTIL_LZ4_BLOCK_H_
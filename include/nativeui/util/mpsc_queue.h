@@ -0,0 +1,144 @@
+// Copyright 2018 Cheng Zhao. All rights reserved.
+// Use of this source code is governed by the license that can be found in the
+// LICENSE file.
+
+#ifndef NATIVEUI_UTIL_MPSC_QUEUE_H_
+#define NATIVEUI_UTIL_MPSC_QUEUE_H_
+
+#include <stddef.h>
+
+#include <atomic>
+
+#include "base/macros.h"
+#include "base/synchronization/lock.h"
+
+namespace nu {
+
+namespace internal {
+
+// Link embedded in every element of an MPSCQueue.
+struct MPSCNode {
+  std::atomic<MPSCNode*> next{nullptr};
+};
+
+// Intrusive, unbounded multi-producer single-consumer queue.
+//
+// Push() can be called from any thread and never blocks or allocates; Pop()
+// must only be called from a single consumer thread. The queue does not own
+// its elements.
+//
+// Pop() may return nullptr while a Push() is halfway done; the element becomes
+// visible once that Push() returns, so callers must arrange to be woken up
+// again after the push (MessageLoop's queues do so with an atomic flag).
+template <typename T>
+class MPSCQueue {
+ public:
+  MPSCQueue() : head_(&stub_), tail_(&stub_) {}
+
+  // T must derive from MPSCNode.
+  void Push(T* node) { PushNode(node); }
+
+  // Returns the oldest element, or nullptr if there is none.
+  T* Pop() {
+    MPSCNode* tail = tail_;
+    MPSCNode* next = tail->next.load(std::memory_order_acquire);
+    if (tail == &stub_) {
+      if (!next)
+        return nullptr;
+      tail_ = next;
+      tail = next;
+      next = next->next.load(std::memory_order_acquire);
+    }
+
+    if (next) {
+      tail_ = next;
+      return static_cast<T*>(tail);
+    }
+
+    // |tail| is the last linked node; unless a push is in progress, put the
+    // stub behind it so it can be handed out.
+    if (tail != head_.load(std::memory_order_acquire))
+      return nullptr;
+
+    PushNode(&stub_);
+    next = tail->next.load(std::memory_order_acquire);
+    if (next) {
+      tail_ = next;
+      return static_cast<T*>(tail);
+    }
+    return nullptr;
+  }
+
+ private:
+  void PushNode(MPSCNode* node) {
+    node->next.store(nullptr, std::memory_order_relaxed);
+    MPSCNode* prev = head_.exchange(node, std::memory_order_acq_rel);
+    prev->next.store(node, std::memory_order_release);
+  }
+
+  std::atomic<MPSCNode*> head_;  // Most recently pushed, touched by producers.
+  MPSCNode* tail_;               // Oldest, only touched by the consumer.
+  MPSCNode stub_;
+
+  DISALLOW_COPY_AND_ASSIGN(MPSCQueue);
+};
+
+// Small cache of free queue nodes shared by producers and the consumer, so
+// steady-state posting does not hit the allocator. Never blocks: when the lock
+// is contended nodes are simply allocated or deleted.
+template <typename T, size_t kMaxSize = 256>
+class MPSCNodePool {
+ public:
+  MPSCNodePool() = default;
+
+  ~MPSCNodePool() {
+    while (free_) {
+      T* node = free_;
+      free_ = static_cast<T*>(node->next.load(std::memory_order_relaxed));
+      delete node;
+    }
+  }
+
+  T* Acquire() {
+    if (lock_.Try()) {
+      T* node = free_;
+      if (node) {
+        free_ = static_cast<T*>(node->next.load(std::memory_order_relaxed));
+        --size_;
+      }
+      lock_.Release();
+      if (node)
+        return node;
+    }
+    return new T;
+  }
+
+  // |node| must have been reset by the caller.
+  void Release(T* node) {
+    if (lock_.Try()) {
+      bool pooled = size_ < kMaxSize;
+      if (pooled) {
+        node->next.store(free_, std::memory_order_relaxed);
+        free_ = node;
+        ++size_;
+      }
+      lock_.Release();
+      if (pooled)
+        return;
+    }
+    delete node;
+  }
+
+ private:
+  base::Lock lock_;
+  T* free_ = nullptr;
+  size_t size_ = 0;
+
+  DISALLOW_COPY_AND_ASSIGN(MPSCNodePool);
+};
+
+}  // namespace internal
+
+}  // namespace nu
+
+#endif  // NATIVEUI_UTIL_MPSC_QUEUE_H_
@@ -0,0 +1,69 @@
+// Copyright 2018 Cheng Zhao. All rights reserved.
+// Use of this source code is governed by the license that can be found in the
+// LICENSE file.
+
+#ifndef NATIVEUI_UTIL_REF_COUNTED_MAPPED_FILE_H_
+#define NATIVEUI_UTIL_REF_COUNTED_MAPPED_FILE_H_
+
+#include <stddef.h>
+
+#include <utility>
+
+#include "base/files/file_path.h"
+#include "base/files/memory_mapped_file.h"
+#include "base/logging.h"
+#include "base/macros.h"
+#include "base/memory/ref_counted_memory.h"
+
+namespace nu {
+
+// A read-only memory mapped file, which stays mapped as long as a reference
+// is held.
+class RefCountedMappedFile : public base::RefCountedMemory {
+ public:
+  RefCountedMappedFile() = default;
+
+  bool Initialize(const base::FilePath& path) { return file_.Initialize(path); }
+
+  // base::RefCountedMemory:
+  const unsigned char* front() const override { return file_.data(); }
+  size_t size() const override { return file_.length(); }
+
+ private:
+  ~RefCountedMappedFile() override = default;
+
+  base::MemoryMappedFile file_;
+
+  DISALLOW_COPY_AND_ASSIGN(RefCountedMappedFile);
+};
+
+// A range of another RefCountedMemory, keeping it alive.
+class RefCountedMemorySlice : public base::RefCountedMemory {
+ public:
+  RefCountedMemorySlice(scoped_refptr<base::RefCountedMemory> memory,
+                        size_t offset,
+                        size_t size)
+      : memory_(std::move(memory)), offset_(offset), size_(size) {
+    DCHECK_LE(offset_, memory_->size());
+    DCHECK_LE(size_, memory_->size() - offset_);
+  }
+
+  // base::RefCountedMemory:
+  const unsigned char* front() const override {
+    return memory_->front() + offset_;
+  }
+  size_t size() const override { return size_; }
+
+ private:
+  ~RefCountedMemorySlice() override = default;
+
+  scoped_refptr<base::RefCountedMemory> memory_;
+  size_t offset_;
+  size_t size_;
+
+  DISALLOW_COPY_AND_ASSIGN(RefCountedMemorySlice);
+};
+
+}  // namespace nu
+
+#endif  // NATIVEUI_UTIL_REF_COUNTED_MAPPED_FILE_H_
@@ -0,0 +1,109 @@
+// Copyright 2018 Cheng Zhao. All rights reserved.
+// Use of this source code is governed by the license that can be found in the
+// LICENSE file.
+
+#ifndef NATIVEUI_UTIL_ROW_HEIGHTS_H_
+#define NATIVEUI_UTIL_ROW_HEIGHTS_H_
+
+#include <stddef.h>
+
+#include <vector>
+
+#include "base/logging.h"
+#include "base/macros.h"
+
+namespace nu {
+
+namespace internal {
+
+// Heights of the rows of a list, with the offsets of rows and the row at an
+// offset found in O(log n) by a Fenwick tree of the heights.
+//
+// Sums are kept as doubles: with floats a 100k rows list would be off by
+// pixels near its end.
+class RowHeights {
+ public:
+  RowHeights() = default;
+
+  int count() const { return static_cast<int>(heights_.size()); }
+
+  void Reset(int count, float height) {
+    heights_.assign(count, height);
+    Rebuild();
+  }
+
+  // Insertion and removal rebuild the tree in O(n).
+  void Insert(int index, int count, float height) {
+    DCHECK(index >= 0 && index <= this->count());
+    heights_.insert(heights_.begin() + index, count, height);
+    Rebuild();
+  }
+
+  void Erase(int index, int count) {
+    DCHECK(index >= 0 && index + count <= this->count());
+    heights_.erase(heights_.begin() + index,
+                   heights_.begin() + index + count);
+    Rebuild();
+  }
+
+  float Get(int index) const { return heights_[index]; }
+
+  void Set(int index, float height) {
+    double delta = static_cast<double>(height) - heights_[index];
+    heights_[index] = height;
+    for (size_t i = index + 1; i < tree_.size(); i += i & (~i + 1))
+      tree_[i] += delta;
+  }
+
+  // Offset of the top of row |index|, which may be count() for the bottom.
+  double Offset(int index) const {
+    DCHECK(index >= 0 && index <= count());
+    double sum = 0;
+    for (size_t i = index; i > 0; i -= i & (~i + 1))
+      sum += tree_[i];
+    return sum;
+  }
+
+  double Total() const { return Offset(count()); }
+
+  // Return the row containing |y|, clamped to the valid rows. The list must
+  // not be empty.
+  int IndexAt(double y) const {
+    DCHECK_GT(count(), 0);
+    size_t pos = 0;
+    for (size_t step = top_bit_; step > 0; step >>= 1) {
+      if (pos + step < tree_.size() && tree_[pos + step] <= y) {
+        pos += step;
+        y -= tree_[pos];
+      }
+    }
+    return pos < heights_.size() ? static_cast<int>(pos) : count() - 1;
+  }
+
+ private:
+  void Rebuild() {
+    size_t n = heights_.size();
+    tree_.assign(n + 1, 0);
+    for (size_t i = 1; i <= n; ++i) {
+      tree_[i] += heights_[i - 1];
+      size_t parent = i + (i & (~i + 1));
+      if (parent <= n)
+        tree_[parent] += tree_[i];
+    }
+    top_bit_ = 1;
+    while (top_bit_ * 2 <= n)
+      top_bit_ *= 2;
+  }
+
+  std::vector<float> heights_;
+  std::vector<double> tree_;  // 1-based.
+  size_t top_bit_ = 1;
+
+  DISALLOW_COPY_AND_ASSIGN(RowHeights);
+};
+
+}  // namespace internal
+
+}  // namespace nu
+
+#endif  // NATIVEUI_UTIL_ROW_HEIGHTS_H_
@@ -0,0 +1,387 @@
+// Copyright 2018 Cheng Zhao. All rights reserved.
+// Use of this source code is governed by the license that can be found in the
+// LICENSE file.
+
+#ifndef NATIVEUI_UTIL_TASK_TRACKER_H_
+#define NATIVEUI_UTIL_TASK_TRACKER_H_
+
+#include <stdint.h>
+
+#include <algorithm>
+#include <atomic>
+#include <deque>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "base/callback.h"
+#include "base/debug/stack_trace.h"
+#include "base/macros.h"
+#include "base/metrics/histogram.h"
+#include "base/metrics/statistics_recorder.h"
+#include "base/strings/stringprintf.h"
+#include "base/synchronization/lock.h"
+#include "base/threading/platform_thread.h"
+#include "base/threading/watchdog.h"
+#include "base/time/time.h"
+#include "build/build_config.h"
+
+#if defined(OS_POSIX)
+#include <pthread.h>
+#include <signal.h>
+#elif defined(OS_WIN)
+#include <windows.h>
+#endif
+
+namespace nu {
+
+// Timing of the tasks that went through one of the message loop's queues.
+struct TaskStats {
+  uint64_t count = 0;
+  // Time between posting a task and starting to run it. For delayed tasks it
+  // is counted from the deadline.
+  base::TimeDelta total_queue_delay;
+  base::TimeDelta max_queue_delay;
+  base::TimeDelta total_run_time;
+  base::TimeDelta max_run_time;
+};
+
+// A task that ran for longer than the long task threshold.
+struct LongTaskReport {
+  const char* queue = "";
+  base::TimeTicks start_time;
+  // Stack of the GUI thread when the threshold was reached, empty if it could
+  // not be captured.
+  base::debug::StackTrace stack{nullptr, 0};
+};
+
+// Snapshot returned by MessageLoop::GetStats().
+struct MessageLoopStats {
+  TaskStats high;
+  TaskStats normal;
+  TaskStats idle;
+  TaskStats delayed;
+  uint64_t long_task_count = 0;
+  // The most recent long tasks, oldest first.
+  std::vector<LongTaskReport> long_tasks;
+};
+
+namespace internal {
+
+// The queue a task was posted to.
+enum class TaskSource {
+  kHigh,
+  kNormal,
+  kIdle,
+  kDelayed,
+};
+
+// Records queueing delay and run time of the message loop's tasks, into
+// counters readable from any thread and into UMA histograms named
+// "NativeUI.MessageLoop.{QueueDelay,RunTime}.<queue>".
+//
+// Optionally watches for long tasks: a base::Watchdog is armed while each task
+// runs, and when it fires the stack of the GUI thread is captured. A task that
+// runs nested tasks, by spinning a loop, is reported when it runs long as a
+// whole, including the time spent in the nested loop.
+//
+// On POSIX the stack is captured by a SIGUSR2 handler on the GUI thread, which
+// builds a base::debug::StackTrace. That calls backtrace(), which is not
+// async-signal-safe: if the signal lands while the GUI thread holds a lock of
+// the allocator or the dynamic loader, the capture can deadlock or crash.
+// Warming up the unwinder beforehand makes this unlikely, not impossible, so
+// detection is meant for debugging and is off by default.
+//
+// Tasks must only be run on the GUI thread.
+class TaskTracker {
+ public:
+  static TaskTracker* Get() {
+    static TaskTracker* tracker = new TaskTracker;
+    return tracker;
+  }
+
+  // Run |task|, which waited |queue_delay| in |source|'s queue.
+  void RunTask(TaskSource source,
+               base::TimeDelta queue_delay,
+               base::OnceClosure task) {
+    Source& s = sources_[static_cast<int>(source)];
+    base::TimeTicks start = base::TimeTicks::Now();
+    // Tasks run nested when one spins a loop, e.g. a menu or a modal dialog,
+    // so the outer task is restored and watched again afterwards.
+    TaskSource outer_source = running_.load();
+    int64_t outer_start_us = running_start_us_.load();
+    bool nested = depth_++ > 0;
+    running_ = source;
+    running_start_us_ = (start - base::TimeTicks()).InMicroseconds();
+    if (detector_)
+      detector_->ArmAtStartTime(start);
+    std::move(task).Run();
+    --depth_;
+    running_ = outer_source;
+    running_start_us_ = outer_start_us;
+    if (detector_) {
+      if (nested)
+        detector_->ArmAtStartTime(
+            base::TimeTicks() +
+            base::TimeDelta::FromMicroseconds(outer_start_us));
+      else
+        detector_->Disarm();
+    }
+    base::TimeDelta run_time = base::TimeTicks::Now() - start;
+
+    // Only this thread writes the counters.
+    Add(&s.count, 1);
+    Add(&s.total_queue_delay_us, queue_delay.InMicroseconds());
+    Max(&s.max_queue_delay_us, queue_delay.InMicroseconds());
+    Add(&s.total_run_time_us, run_time.InMicroseconds());
+    Max(&s.max_run_time_us, run_time.InMicroseconds());
+    s.queue_delay_histogram->AddTime(queue_delay);
+    s.run_time_histogram->AddTime(run_time);
+  }
+
+  // Capture the GUI thread's stack whenever a task runs for longer than
+  // |threshold|. A zero threshold turns detection off. Must be called on the
+  // GUI thread.
+  void SetLongTaskThreshold(base::TimeDelta threshold) {
+    detector_.reset();
+    if (threshold > base::TimeDelta())
+      detector_.reset(new LongTaskDetector(threshold));
+  }
+
+  MessageLoopStats GetStats() {
+    MessageLoopStats stats;
+    stats.high = Snapshot(TaskSource::kHigh);
+    stats.normal = Snapshot(TaskSource::kNormal);
+    stats.idle = Snapshot(TaskSource::kIdle);
+    stats.delayed = Snapshot(TaskSource::kDelayed);
+    base::AutoLock auto_lock(lock_);
+    stats.long_task_count = long_task_count_;
+    stats.long_tasks.assign(long_tasks_.begin(), long_tasks_.end());
+    return stats;
+  }
+
+  std::string DumpStats() {
+    MessageLoopStats stats = GetStats();
+    std::string out = "MessageLoop tasks:\n";
+    const std::pair<const char*, const TaskStats*> queues[] = {
+      {"high", &stats.high}, {"normal", &stats.normal},
+      {"idle", &stats.idle}, {"delayed", &stats.delayed},
+    };
+    for (const auto& queue : queues) {
+      const TaskStats& s = *queue.second;
+      uint64_t count = std::max<uint64_t>(s.count, 1);
+      base::StringAppendF(
+          &out,
+          "  %-8s count=%llu queue_delay avg=%lldus max=%lldus "
+          "run_time avg=%lldus max=%lldus\n",
+          queue.first, static_cast<unsigned long long>(s.count),
+          static_cast<long long>(s.total_queue_delay.InMicroseconds() / count),
+          static_cast<long long>(s.max_queue_delay.InMicroseconds()),
+          static_cast<long long>(s.total_run_time.InMicroseconds() / count),
+          static_cast<long long>(s.max_run_time.InMicroseconds()));
+    }
+    base::StringAppendF(&out, "Long tasks: %llu\n",
+                        static_cast<unsigned long long>(stats.long_task_count));
+    for (const LongTaskReport& report : stats.long_tasks) {
+      base::StringAppendF(
+          &out, "  %s task started %lldms ago:\n", report.queue,
+          static_cast<long long>(
+              (base::TimeTicks::Now() - report.start_time).InMilliseconds()));
+      out += report.stack.ToString();
+    }
+    base::StatisticsRecorder::WriteGraph("NativeUI.MessageLoop", &out);
+    return out;
+  }
+
+ private:
+  static constexpr int kSourceCount = 4;
+
+  // Number of long task reports kept.
+  static constexpr size_t kMaxLongTasks = 16;
+
+  struct Source {
+    std::atomic<int64_t> count{0};
+    std::atomic<int64_t> total_queue_delay_us{0};
+    std::atomic<int64_t> max_queue_delay_us{0};
+    std::atomic<int64_t> total_run_time_us{0};
+    std::atomic<int64_t> max_run_time_us{0};
+    base::HistogramBase* queue_delay_histogram = nullptr;
+    base::HistogramBase* run_time_histogram = nullptr;
+  };
+
+  // Fires when a task runs past the threshold, on the watchdog's thread.
+  class LongTaskDetector : public base::Watchdog {
+   public:
+    explicit LongTaskDetector(base::TimeDelta threshold)
+        : base::Watchdog(threshold, "GUI thread", true) {
+#if defined(OS_POSIX)
+      thread_ = pthread_self();
+      // Warm up the unwinder, which may load libraries on first use, outside
+      // of the signal handler.
+      slot()->stack = base::debug::StackTrace();
+      struct sigaction action = {};
+      action.sa_handler = &LongTaskDetector::OnCaptureSignal;
+      action.sa_flags = SA_RESTART;
+      sigemptyset(&action.sa_mask);
+      sigaction(kCaptureSignal, &action, &previous_action_);
+#elif defined(OS_WIN)
+      thread_ = ::OpenThread(THREAD_SUSPEND_RESUME | THREAD_GET_CONTEXT |
+                                 THREAD_QUERY_INFORMATION,
+                             FALSE, ::GetCurrentThreadId());
+#endif
+    }
+
+    ~LongTaskDetector() override {
+      // Stop the watchdog thread before the capture machinery goes away.
+      Cleanup();
+      while (!IsJoinable())
+        base::PlatformThread::Sleep(base::TimeDelta::FromMilliseconds(1));
+#if defined(OS_POSIX)
+      sigaction(kCaptureSignal, &previous_action_, nullptr);
+#elif defined(OS_WIN)
+      if (thread_)
+        ::CloseHandle(thread_);
+#endif
+    }
+
+    void Alarm() override {
+      TaskTracker* tracker = TaskTracker::Get();
+      LongTaskReport report;
+      report.queue = SourceName(tracker->running_.load());
+      report.start_time = base::TimeTicks() + base::TimeDelta::FromMicroseconds(
+          tracker->running_start_us_.load());
+      CaptureStack(&report.stack);
+      tracker->AddLongTask(std::move(report));
+    }
+
+   private:
+#if defined(OS_POSIX)
+    static constexpr int kCaptureSignal = SIGUSR2;
+
+    // Written by the signal handler on the GUI thread, read by Alarm().
+    struct CaptureSlot {
+      std::atomic<bool> done{false};
+      base::debug::StackTrace stack{nullptr, 0};
+    };
+
+    static CaptureSlot* slot() {
+      static CaptureSlot* slot = new CaptureSlot;
+      return slot;
+    }
+
+    // Not async-signal-safe, see the comment of TaskTracker.
+    static void OnCaptureSignal(int) {
+      CaptureSlot* s = slot();
+      s->stack = base::debug::StackTrace();
+      s->done.store(true, std::memory_order_release);
+    }
+
+    void CaptureStack(base::debug::StackTrace* stack) {
+      CaptureSlot* s = slot();
+      s->done.store(false);
+      if (pthread_kill(thread_, kCaptureSignal) != 0)
+        return;
+      for (int i = 0; i < 100 && !s->done.load(std::memory_order_acquire); ++i)
+        base::PlatformThread::Sleep(base::TimeDelta::FromMilliseconds(1));
+      if (s->done.load(std::memory_order_acquire))
+        *stack = s->stack;
+    }
+
+    pthread_t thread_;
+    struct sigaction previous_action_;
+#elif defined(OS_WIN)
+    void CaptureStack(base::debug::StackTrace* stack) {
+      if (!thread_ || ::SuspendThread(thread_) == static_cast<DWORD>(-1))
+        return;
+      CONTEXT context = {};
+      context.ContextFlags = CONTEXT_FULL;
+      if (::GetThreadContext(thread_, &context))
+        *stack = base::debug::StackTrace(&context);
+      ::ResumeThread(thread_);
+    }
+
+    HANDLE thread_;
+#else
+    void CaptureStack(base::debug::StackTrace* stack) {}
+#endif
+
+    DISALLOW_COPY_AND_ASSIGN(LongTaskDetector);
+  };
+
+  static const char* SourceName(TaskSource source) {
+    static const char* const kNames[kSourceCount] = {
+      "High", "Normal", "Idle", "Delayed",
+    };
+    return kNames[static_cast<int>(source)];
+  }
+
+  TaskTracker() {
+    for (int i = 0; i < kSourceCount; ++i) {
+      const char* name = SourceName(static_cast<TaskSource>(i));
+      // Same buckets as UMA_HISTOGRAM_TIMES.
+      sources_[i].queue_delay_histogram = base::Histogram::FactoryTimeGet(
+          std::string("NativeUI.MessageLoop.QueueDelay.") + name,
+          base::TimeDelta::FromMilliseconds(1),
+          base::TimeDelta::FromSeconds(10), 50,
+          base::HistogramBase::kUmaTargetedHistogramFlag);
+      sources_[i].run_time_histogram = base::Histogram::FactoryTimeGet(
+          std::string("NativeUI.MessageLoop.RunTime.") + name,
+          base::TimeDelta::FromMilliseconds(1),
+          base::TimeDelta::FromSeconds(10), 50,
+          base::HistogramBase::kUmaTargetedHistogramFlag);
+    }
+  }
+
+  static void Add(std::atomic<int64_t>* counter, int64_t value) {
+    counter->store(counter->load(std::memory_order_relaxed) + value,
+                   std::memory_order_relaxed);
+  }
+
+  static void Max(std::atomic<int64_t>* counter, int64_t value) {
+    if (value > counter->load(std::memory_order_relaxed))
+      counter->store(value, std::memory_order_relaxed);
+  }
+
+  TaskStats Snapshot(TaskSource source) const {
+    const Source& s = sources_[static_cast<int>(source)];
+    TaskStats stats;
+    stats.count = s.count.load(std::memory_order_relaxed);
+    stats.total_queue_delay = base::TimeDelta::FromMicroseconds(
+        s.total_queue_delay_us.load(std::memory_order_relaxed));
+    stats.max_queue_delay = base::TimeDelta::FromMicroseconds(
+        s.max_queue_delay_us.load(std::memory_order_relaxed));
+    stats.total_run_time = base::TimeDelta::FromMicroseconds(
+        s.total_run_time_us.load(std::memory_order_relaxed));
+    stats.max_run_time = base::TimeDelta::FromMicroseconds(
+        s.max_run_time_us.load(std::memory_order_relaxed));
+    return stats;
+  }
+
+  void AddLongTask(LongTaskReport report) {
+    base::AutoLock auto_lock(lock_);
+    ++long_task_count_;
+    if (long_tasks_.size() == kMaxLongTasks)
+      long_tasks_.pop_front();
+    long_tasks_.push_back(std::move(report));
+  }
+
+  Source sources_[kSourceCount];
+  // The task being run, read by the long task detector.
+  std::atomic<TaskSource> running_{TaskSource::kNormal};
+  std::atomic<int64_t> running_start_us_{0};
+  int depth_ = 0;  // Number of tasks being run, nested ones included.
+  std::unique_ptr<LongTaskDetector> detector_;
+
+  base::Lock lock_;  // Protects the long task reports.
+  uint64_t long_task_count_ = 0;
+  std::deque<LongTaskReport> long_tasks_;
+
+  DISALLOW_COPY_AND_ASSIGN(TaskTracker);
+};
+
+}  // namespace internal
+
+}  // namespace nu
+
+#endif  // NATIVEUI_UTIL_TASK_TRACKER_H_
@@ -0,0 +1,243 @@
+// Copyright 2018 Cheng Zhao. All rights reserved.
+// Use of this source code is governed by the license that can be found in the
+// LICENSE file.
+
+#ifndef NATIVEUI_UTIL_TIMER_WHEEL_H_
+#define NATIVEUI_UTIL_TIMER_WHEEL_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <algorithm>
+#include <limits>
+#include <utility>
+#include <vector>
+
+#include "base/bits.h"
+#include "base/callback.h"
+#include "base/containers/linked_list.h"
+#include "base/logging.h"
+#include "base/macros.h"
+#include "base/memory/ref_counted.h"
+
+namespace nu {
+
+namespace internal {
+
+// A task registered in a TimerWheel.
+//
+// Entries are reference counted so handles can outlive them; the wheel holds
+// one reference while the entry is in it.
+class TimerWheelEntry : public base::RefCountedThreadSafe<TimerWheelEntry>,
+                        public base::LinkNode<TimerWheelEntry> {
+ public:
+  TimerWheelEntry(uint64_t deadline, base::OnceClosure task)
+      : deadline_(deadline), task_(std::move(task)) {}
+
+  uint64_t deadline() const { return deadline_; }
+  base::OnceClosure& task() { return task_; }
+
+  // Whether the entry is currently in a wheel.
+  bool in_wheel() const { return level_ >= 0; }
+
+ private:
+  friend class base::RefCountedThreadSafe<TimerWheelEntry>;
+  friend class TimerWheel;
+
+  ~TimerWheelEntry() = default;
+
+  uint64_t deadline_;
+  base::OnceClosure task_;
+  int level_ = -1;
+  int slot_ = 0;
+
+  DISALLOW_COPY_AND_ASSIGN(TimerWheelEntry);
+};
+
+// Hierarchical timer wheel, see Varghese & Lauck, "Hashed and Hierarchical
+// Timing Wheels".
+//
+// Time is measured in ticks. Level 0 has one slot per tick, and each level
+// above has slots 64 times wider. Adding and removing entries is O(1). An
+// entry is moved down at most once per level, when time reaches the start of
+// its slot. Empty stretches of time are skipped using a bitmap of occupied
+// slots per level, so advancing past a long idle period is cheap. Deadlines
+// past the top level's range wait in an overflow list.
+//
+// This class is not thread-safe.
+class TimerWheel {
+ public:
+  static constexpr int kLevels = 6;
+  static constexpr int kSlotBits = 6;
+  static constexpr int kSlots = 1 << kSlotBits;
+
+  explicit TimerWheel(uint64_t now) : now_(now) {}
+
+  ~TimerWheel() {
+    for (auto& level : slots_) {
+      for (auto& slot : level) {
+        while (!slot.empty())
+          Take(slot.head()->value())->Release();
+      }
+    }
+    while (!overflow_.empty())
+      Take(overflow_.head()->value())->Release();
+  }
+
+  uint64_t now() const { return now_; }
+  size_t size() const { return size_; }
+
+  // Add |entry|, which must not be in a wheel. Entries whose deadline has
+  // passed expire on the next Advance().
+  void Add(TimerWheelEntry* entry) {
+    DCHECK(!entry->in_wheel());
+    entry->AddRef();
+    Place(entry);
+    ++size_;
+  }
+
+  // Remove |entry| from the wheel. Returns false if it was not in it.
+  bool Remove(TimerWheelEntry* entry) {
+    if (!entry->in_wheel())
+      return false;
+    Take(entry)->Release();
+    return true;
+  }
+
+  // Move time forward to |now| and append the expired entries to |expired|,
+  // ordered by deadline and, for equal deadlines, by insertion.
+  void Advance(uint64_t now,
+               std::vector<scoped_refptr<TimerWheelEntry>>* expired) {
+    now = std::max(now, now_);
+    for (;;) {
+      Cascade();
+      Expire(expired);
+      if (now_ >= now)
+        return;
+      now_ = std::min(NextEventTick(), now);
+    }
+  }
+
+  // The tick at which Advance() next has work to do: an entry expires, or
+  // entries move down a level. Returns the maximum uint64_t when empty.
+  uint64_t NextEventTick() const {
+    uint64_t next = std::numeric_limits<uint64_t>::max();
+    for (int level = 0; level < kLevels; ++level) {
+      int shift = kSlotBits * level;
+      int current = static_cast<int>((now_ >> shift) & (kSlots - 1));
+      // Level 0 includes the current slot; higher levels never hold entries
+      // in theirs.
+      uint64_t pending = level == 0 ? ~uint64_t{0} << current
+                                    : current == kSlots - 1
+                                          ? 0
+                                          : ~uint64_t{0} << (current + 1);
+      uint64_t occupied = occupied_[level] & pending;
+      if (!occupied)
+        continue;
+      uint64_t slot = base::bits::CountTrailingZeroBits(occupied);
+      uint64_t block = (now_ >> (shift + kSlotBits)) << (shift + kSlotBits);
+      next = std::min(next, block + (slot << shift));
+    }
+    if (!overflow_.empty())
+      next = std::min(next, ((now_ >> kRangeBits) + 1) << kRangeBits);
+    return next;
+  }
+
+ private:
+  // Number of low bits of a tick covered by the wheel's levels.
+  static constexpr int kRangeBits = kSlotBits * kLevels;
+
+  // Put |entry| in the lowest level whose current block contains its
+  // deadline.
+  void Place(TimerWheelEntry* entry) {
+    uint64_t deadline = std::max(entry->deadline_, now_);
+
+    // Past the top level's current block: wait in the overflow list for the
+    // next block to start.
+    if ((deadline ^ now_) >> kRangeBits != 0) {
+      entry->level_ = kLevels;
+      entry->slot_ = 0;
+      overflow_.Append(entry);
+      return;
+    }
+
+    int level = 0;
+    while (((deadline ^ now_) >> (kSlotBits * (level + 1))) != 0)
+      ++level;
+
+    int slot = static_cast<int>((deadline >> (kSlotBits * level)) &
+                                (kSlots - 1));
+    entry->level_ = level;
+    entry->slot_ = slot;
+    slots_[level][slot].Append(entry);
+    occupied_[level] |= uint64_t{1} << slot;
+  }
+
+  // Unlink |entry| and return it, still holding the wheel's reference.
+  TimerWheelEntry* Take(TimerWheelEntry* entry) {
+    int level = entry->level_;
+    int slot = entry->slot_;
+    entry->RemoveFromList();
+    entry->level_ = -1;
+    if (level < kLevels && slots_[level][slot].empty())
+      occupied_[level] &= ~(uint64_t{1} << slot);
+    --size_;
+    return entry;
+  }
+
+  // Move the entries of the slots starting at the current tick one or more
+  // levels down, highest level first.
+  void Cascade() {
+    if ((now_ & ((uint64_t{1} << kRangeBits) - 1)) == 0) {
+      // Entries still past the new block go back to |overflow_|, so it is
+      // emptied first to not visit them again.
+      base::LinkedList<TimerWheelEntry> overflow;
+      while (!overflow_.empty()) {
+        TimerWheelEntry* entry = overflow_.head()->value();
+        entry->RemoveFromList();
+        overflow.Append(entry);
+      }
+      while (!overflow.empty()) {
+        TimerWheelEntry* entry = overflow.head()->value();
+        entry->RemoveFromList();
+        Place(entry);
+      }
+    }
+    for (int level = kLevels - 1; level > 0; --level) {
+      int shift = kSlotBits * level;
+      if (now_ & ((uint64_t{1} << shift) - 1))
+        continue;
+      int slot = static_cast<int>((now_ >> shift) & (kSlots - 1));
+      auto& list = slots_[level][slot];
+      while (!list.empty()) {
+        TimerWheelEntry* entry = Take(list.head()->value());
+        Place(entry);
+        ++size_;
+      }
+    }
+  }
+
+  void Expire(std::vector<scoped_refptr<TimerWheelEntry>>* expired) {
+    int slot = static_cast<int>(now_ & (kSlots - 1));
+    auto& list = slots_[0][slot];
+    while (!list.empty()) {
+      TimerWheelEntry* entry = Take(list.head()->value());
+      expired->push_back(entry);
+      entry->Release();
+    }
+  }
+
+  uint64_t now_;
+  size_t size_ = 0;
+  uint64_t occupied_[kLevels] = {};
+  base::LinkedList<TimerWheelEntry> slots_[kLevels][kSlots];
+  base::LinkedList<TimerWheelEntry> overflow_;
+
+  DISALLOW_COPY_AND_ASSIGN(TimerWheel);
+};
+
+}  // namespace internal
+
+}  // namespace nu
+
+#endif  // NATIVEUI_UTIL_TIMER_WHEEL_H_
@@ -1,6 +1,8 @@
 #pragma once
 #include <atomic>
 #include <cassert>
+#include <cstddef>
+#include <mutex>
 
 namespace observable { namespace detail {
 
@@ -8,7 +10,18 @@ namespace observable { namespace detail {
 //! them.
 //!
 //! All methods of the collection can be safely called in parallel, from multiple
-//! threads.
+//! threads. None of the methods block or spin waiting for another thread.
+//!
+//! Removed elements are unlinked from the collection's list right away, but
+//! their memory is only reclaimed once no apply() call that could still be
+//! looking at them is running (epoch-based reclamation). Reclaimed nodes are
+//! kept in a small pool and reused by later insert() calls.
+//!
+//! An element removed while no apply() or empty() call is running, e.g. an
+//! observer unsubscribed outside of a notification, is destroyed before
+//! remove() returns. One removed while such a call is running, including from
+//! inside the functor passed to apply(), is destroyed by a later insert() or
+//! remove(), or by the collection's destructor.
 //!
 //! \warning The order of elements inside the collection is unspecified.
 //!
@@ -43,21 +56,19 @@ public:
     auto insert(ValueType_ && element)
     {
         auto const i = ++last_id_;
-        auto n = std::make_unique<node>();
+        auto const n = acquire_node();
         n->node_id = i;
         n->element = std::forward<ValueType_>(element);
+        n->deleted.store(false);
 
-        {
-            auto const block_gc = gc_blocker { this };
-
-            n->next = head_.load();
-            while(!head_.compare_exchange_weak(n->next, n.get()))
-                ;
+        auto head = head_.load();
+        do
+            n->next.store(head);
+        while(!head_.compare_exchange_weak(head, n));
 
-            n.release();
-        }
+        if(needs_gc())
+            gc();
 
-        gc();
         return i;
     }
 
@@ -78,9 +89,9 @@ public:
     {
         auto deleted = false;
         {
-            auto const block_gc = gc_blocker { this };
+            auto const guard = epoch_guard { this };
 
-            for(auto n = head_.load(); n; n = n->next)
+            for(auto n = head_.load(); n; n = n->next.load())
             {
                 if(n->node_id != element_id)
                     continue;
@@ -90,6 +101,9 @@ public:
             }
         }
 
+        if(deleted)
+            ++unlinkable_;
+
         gc();
         return deleted;
     }
@@ -113,9 +127,9 @@ public:
     template <typename UnaryFunctor>
     void apply(UnaryFunctor && fun) const noexcept(noexcept(fun(ValueType { })))
     {
-        auto const block_gc = gc_blocker { this };
+        auto const guard = epoch_guard { this };
 
-        for(auto n = head_.load(); n; n = n->next)
+        for(auto n = head_.load(); n; n = n->next.load())
         {
             if(n->deleted.load())
                 continue;
@@ -127,18 +141,24 @@ public:
     //! Return true if the collection has no elements.
     auto empty() const noexcept
     {
-        auto const block_gc = gc_blocker { this };
-        auto const h = head_.load();
-        return !h || h->deleted;
+        auto const guard = epoch_guard { this };
+
+        for(auto n = head_.load(); n; n = n->next.load())
+            if(!n->deleted.load())
+                return false;
+
+        return true;
     }
 
     //! Destructor.
     ~collection() noexcept
     {
-        for(auto n = head_.load(); n; n = n->next)
-            n->deleted.store(true);
+        delete_list(head_.load(), &node::next);
 
-        gc();
+        for(auto & l : limbo_)
+            delete_list(l, &node::limbo_next);
+
+        delete_list(pool_, &node::limbo_next);
     }
 
 public:
@@ -155,73 +175,232 @@ public:
     auto operator=(collection &&) -> collection & =delete;
 
 private:
-    //! Delete any nodes marked as deleted.
+    //! Node data.
+    struct node
+    {
+        std::atomic<node *> next { nullptr };
+        ValueType element;
+        std::atomic<bool> deleted { false };
+        id node_id;
+
+        //! Link used while the node is retired or pooled. Only touched by the
+        //! thread running gc(), or while holding the pool mutex.
+        node * limbo_next { nullptr };
+    };
+
+    //! Number of epochs that are tracked. A node retired in epoch ``e`` is
+    //! reclaimed when advancing to epoch ``e + 3``, at which point no reader
+    //! that entered in epoch ``e`` or earlier can still be running.
+    static constexpr std::size_t epoch_count = 3;
+
+    //! Maximum number of reclaimed nodes kept around for reuse.
+    static constexpr std::size_t max_pool_size = 64;
+
+    //! Announce a reader for the duration of an instance's lifetime.
+    //!
+    //! Readers never wait for gc(); if the epoch moves while a reader is being
+    //! announced, the announcement is simply repeated in the new epoch.
+    struct epoch_guard
+    {
+        explicit epoch_guard(collection<ValueType> const * c) noexcept :
+            collection_ { c }
+        {
+            for(;;)
+            {
+                auto const e = collection_->epoch_.load();
+                slot_ = e % epoch_count;
+                ++collection_->readers_[slot_];
+                if(collection_->epoch_.load() == e)
+                    break;
+
+                --collection_->readers_[slot_];
+            }
+        }
+
+        ~epoch_guard() noexcept
+        {
+            --collection_->readers_[slot_];
+        }
+
+        epoch_guard() =delete;
+        epoch_guard(epoch_guard const &) =delete;
+        auto operator=(epoch_guard const &) -> epoch_guard & =delete;
+        epoch_guard(epoch_guard &&) =default;
+        auto operator=(epoch_guard &&) -> epoch_guard & =default;
+
+    private:
+        collection<ValueType> const * collection_;
+        std::size_t slot_ { 0 };
+    };
+
+    //! Return true if gc() has any work to do.
+    auto needs_gc() const noexcept
+    {
+        return unlinkable_.load() > 0 || retired_.load() > 0;
+    }
+
+    //! Unlink any nodes marked as deleted and reclaim the nodes that are no
+    //! longer reachable by any reader.
+    //!
+    //! Only one thread runs gc() at a time; other threads calling it while it is
+    //! running return immediately.
     void gc() noexcept
     {
-        if(block_gc_.load() > 0 || gc_active_.exchange(true))
+        if(gc_active_.exchange(true))
             return;
 
-        auto head = head_.load();
-        for(auto p = &head; *p && block_gc_ == 0;)
+        node * unlinked = nullptr;
+        std::size_t unlinked_count = 0;
+
+        // Only gc() changes the next pointer of a linked node; insert() only
+        // pushes new nodes on top of head_.
+        node * prev = nullptr;
+        auto n = unlinkable_.load() != 0 ? head_.load() : nullptr;
+        while(n)
         {
-            if(!(*p)->deleted.load())
+            auto const next = n->next.load();
+            if(!n->deleted.load())
             {
-                p = &((*p)->next);
+                prev = n;
+                n = next;
                 continue;
             }
 
-            auto d = *p;
-            *p = (*p)->next;
-            delete d;
+            if(prev)
+            {
+                prev->next.store(next);
+            }
+            else
+            {
+                auto expected = n;
+                if(!head_.compare_exchange_strong(expected, next))
+                {
+                    // New nodes have been pushed on top of n; walk again from
+                    // the new head to find its predecessor.
+                    n = head_.load();
+                    continue;
+                }
+            }
+
+            n->limbo_next = unlinked;
+            unlinked = n;
+            ++unlinked_count;
+            n = next;
+        }
+
+        unlinkable_ -= unlinked_count;
+
+        auto e = epoch_.load();
+        if(unlinked)
+        {
+            auto tail = unlinked;
+            while(tail->limbo_next)
+                tail = tail->limbo_next;
+
+            tail->limbo_next = limbo_[e % epoch_count];
+            limbo_[e % epoch_count] = unlinked;
+            retired_ += unlinked_count;
+        }
+
+        // Advance the epoch once the readers of the previous one are gone. The
+        // slot being reused held nodes retired two epochs ago, which nobody can
+        // reach anymore. With no readers at all, which is the usual case when
+        // removing outside of apply(), going through every slot reclaims the
+        // nodes retired just now, so their elements are destroyed right away.
+        for(std::size_t i = 0; i < epoch_count && retired_.load() > 0; ++i)
+        {
+            if(readers_[(e + epoch_count - 1) % epoch_count].load() != 0)
+                break;
+
+            auto & reclaimable = limbo_[(e + 1) % epoch_count];
+            auto n = reclaimable;
+            reclaimable = nullptr;
+            epoch_.store(++e);
 
-            if(p == &head)
-                head_.store(*p);
+            while(n)
+            {
+                auto const d = n;
+                n = n->limbo_next;
+                --retired_;
+                release_node(d);
+            }
         }
 
         gc_active_.store(false);
     }
 
-    //! Block the gc() method from running for the duration of an instance's
-    //! lifetime.
-    struct gc_blocker
+    //! Take a node from the pool, or allocate a new one.
+    auto acquire_node() -> node *
     {
-        explicit gc_blocker(collection<ValueType> const * c) noexcept :
-            collection_{ c }
         {
-            ++collection_->block_gc_;
-            while(collection_->gc_active_.load())
-                ;
+            std::unique_lock<std::mutex> const lock { pool_mutex_, std::try_to_lock };
+            if(lock && pool_)
+            {
+                auto const n = pool_;
+                pool_ = n->limbo_next;
+                n->limbo_next = nullptr;
+                --pool_size_;
+                return n;
+            }
         }
 
-        ~gc_blocker() noexcept
+        return new node;
+    }
+
+    //! Return a reclaimed node to the pool, or delete it if the pool is full.
+    void release_node(node * n) noexcept
+    {
+        n->element = ValueType { };
+
         {
-            --collection_->block_gc_;
+            std::unique_lock<std::mutex> const lock { pool_mutex_, std::try_to_lock };
+            if(lock && pool_size_ < max_pool_size)
+            {
+                n->limbo_next = pool_;
+                pool_ = n;
+                ++pool_size_;
+                return;
+            }
         }
 
-        gc_blocker() =delete;
-        gc_blocker(gc_blocker const &) =delete;
-        auto operator=(gc_blocker const &) -> gc_blocker & =delete;
-        gc_blocker(gc_blocker &&) =default;
-        auto operator=(gc_blocker &&) -> gc_blocker & =default;
+        delete n;
+    }
 
-    private:
-        collection<ValueType> const * collection_;
-    };
+    template <typename Next>
+    static void delete_list(node * n, Next next) noexcept
+    {
+        while(n)
+        {
+            auto const d = n;
+            n = next_of(n, next);
+            delete d;
+        }
+    }
 
-    //! Node data.
-    struct node
+    static auto next_of(node * n, std::atomic<node *> node::* next) noexcept
     {
-        node * next { nullptr };
-        ValueType element;
-        std::atomic<bool> deleted { false };
-        id node_id;
-    };
+        return (n->*next).load();
+    }
+
+    static auto next_of(node * n, node * node::* next) noexcept
+    {
+        return n->*next;
+    }
 
 private:
     std::atomic<node *> head_ { nullptr };
-    mutable std::atomic<std::size_t> block_gc_ { 0 };
-    std::atomic<bool> gc_active_ { false };
     std::atomic<id> last_id_ { 0 };
+
+    mutable std::atomic<std::size_t> epoch_ { 0 };
+    mutable std::atomic<std::size_t> readers_[epoch_count] { };
+    std::atomic<bool> gc_active_ { false };
+    std::atomic<std::size_t> unlinkable_ { 0 };
+    std::atomic<std::size_t> retired_ { 0 };
+    node * limbo_[epoch_count] { };
+
+    std::mutex pool_mutex_;
+    node * pool_ { nullptr };
+    std::size_t pool_size_ { 0 };
 };
 
 } }
@@ -0,0 +1,180 @@
+#pragma once
+#include <cassert>
+#include <cstddef>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+namespace observable { namespace detail {
+
+//! \cond
+template <typename Signature, std::size_t Capacity = 4 * sizeof(void *)>
+class small_function;
+//! \endcond
+
+//! Move-only, type-erased callable with inline storage for small functors.
+//!
+//! This works like a ``std::function`` that cannot be copied. Functors that fit
+//! inside ``Capacity`` bytes and are nothrow move-constructible are stored
+//! inline, without allocating; larger functors are stored on the heap.
+//!
+//! Lambdas capturing a few pointers, references or smart pointers fit in the
+//! default capacity.
+//!
+//! \tparam R Return type.
+//! \tparam Args Argument types.
+//! \tparam Capacity Size, in bytes, of the inline storage.
+//!
+//! \ingroup observable_detail
+template <typename R, typename ... Args, std::size_t Capacity>
+class small_function<R(Args ...), Capacity> final
+{
+    template <typename F>
+    using enable_if_callable = std::enable_if_t<
+                                    !std::is_same<std::decay_t<F>, small_function>::value &&
+                                    !std::is_same<std::decay_t<F>, std::nullptr_t>::value>;
+
+public:
+    //! Create an empty function.
+    small_function() noexcept =default;
+
+    //! Create an empty function.
+    small_function(std::nullptr_t) noexcept { }
+
+    //! Create a function storing the provided functor.
+    //!
+    //! \param[in] fun Functor to store. Must be callable with ``Args ...`` and
+    //!                return something convertible to ``R``.
+    template <typename F, typename = enable_if_callable<F>>
+    small_function(F && fun)
+    {
+        emplace<std::decay_t<F>>(std::forward<F>(fun));
+    }
+
+    //! Call the stored functor.
+    //!
+    //! \warning The function must not be empty.
+    auto operator()(Args ... args) const -> R
+    {
+        assert(ops_);
+        return ops_->call(&storage_, std::forward<Args>(args) ...);
+    }
+
+    //! Return true if the function is not empty.
+    explicit operator bool() const noexcept { return ops_ != nullptr; }
+
+    //! Destroy the stored functor, if any.
+    void reset() noexcept
+    {
+        if(!ops_)
+            return;
+
+        ops_->destroy(&storage_);
+        ops_ = nullptr;
+    }
+
+    //! Destructor.
+    ~small_function() { reset(); }
+
+public:
+    //! Functions are not copy-constructible.
+    small_function(small_function const &) =delete;
+
+    //! Functions are not copy-assignable.
+    auto operator=(small_function const &) -> small_function & =delete;
+
+    //! Functions are move-constructible. The moved-from function is empty.
+    small_function(small_function && other) noexcept { take(other); }
+
+    //! Functions are move-assignable. The moved-from function is empty.
+    auto operator=(small_function && other) noexcept -> small_function &
+    {
+        if(this != &other)
+        {
+            reset();
+            take(other);
+        }
+
+        return *this;
+    }
+
+private:
+    using storage_type = std::aligned_storage_t<Capacity, alignof(std::max_align_t)>;
+
+    struct operations
+    {
+        R (*call)(void *, Args && ...);
+        void (*move)(void *, void *) noexcept;
+        void (*destroy)(void *) noexcept;
+    };
+
+    template <typename F>
+    static constexpr bool fits_inline = sizeof(F) <= Capacity &&
+                                        alignof(F) <= alignof(std::max_align_t) &&
+                                        std::is_nothrow_move_constructible<F>::value;
+
+    //! Operations for functors stored in the inline storage.
+    template <typename F>
+    static auto inline_operations() noexcept -> operations const *
+    {
+        static operations const ops {
+            [](void * s, Args && ... args) -> R {
+                return static_cast<R>((*static_cast<F *>(s))(std::forward<Args>(args) ...));
+            },
+            [](void * from, void * to) noexcept {
+                ::new(to) F(std::move(*static_cast<F *>(from)));
+                static_cast<F *>(from)->~F();
+            },
+            [](void * s) noexcept { static_cast<F *>(s)->~F(); }
+        };
+
+        return &ops;
+    }
+
+    //! Operations for functors stored on the heap; the storage holds a pointer.
+    template <typename F>
+    static auto heap_operations() noexcept -> operations const *
+    {
+        static operations const ops {
+            [](void * s, Args && ... args) -> R {
+                return static_cast<R>((**static_cast<F **>(s))(std::forward<Args>(args) ...));
+            },
+            [](void * from, void * to) noexcept {
+                ::new(to) F * { *static_cast<F **>(from) };
+            },
+            [](void * s) noexcept { delete *static_cast<F **>(s); }
+        };
+
+        return &ops;
+    }
+
+    template <typename F, typename Fun>
+    auto emplace(Fun && fun) -> std::enable_if_t<fits_inline<F>>
+    {
+        ::new(&storage_) F(std::forward<Fun>(fun));
+        ops_ = inline_operations<F>();
+    }
+
+    template <typename F, typename Fun>
+    auto emplace(Fun && fun) -> std::enable_if_t<!fits_inline<F>>
+    {
+        ::new(&storage_) F * { new F(std::forward<Fun>(fun)) };
+        ops_ = heap_operations<F>();
+    }
+
+    void take(small_function & other) noexcept
+    {
+        if(!other.ops_)
+            return;
+
+        other.ops_->move(&other.storage_, &storage_);
+        ops_ = other.ops_;
+        other.ops_ = nullptr;
+    }
+
+private:
+    mutable storage_type storage_;
+    operations const * ops_ { nullptr };
+};
+
+} }
@@ -0,0 +1,182 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace observable { namespace detail {
+
+//! Fixed-size pool of threads that run index-based jobs.
+//!
+//! A job calls a functor once for every index in ``[0, count)``. The calling
+//! thread takes part in the job, and the worker threads claim small chunks of
+//! indices from a shared counter until none are left, so faster threads end up
+//! doing more of the work.
+//!
+//! Worker threads are only started when the first job runs.
+//!
+//! \warning Only one job can run at a time; run() must not be called
+//!          concurrently, or from inside a running job.
+//!
+//! \ingroup observable_detail
+class work_pool final
+{
+public:
+    //! Create a pool.
+    //!
+    //! \param[in] thread_count Number of worker threads to use, in addition to
+    //!                         the thread calling run().
+    explicit work_pool(std::size_t thread_count) noexcept :
+        thread_count_ { thread_count }
+    { }
+
+    //! Return the number of worker threads.
+    auto thread_count() const noexcept { return thread_count_; }
+
+    //! Call a functor for all indices in ``[0, count)``, in parallel.
+    //!
+    //! The method returns after all the calls have returned. If any of the
+    //! calls throws, the first exception is rethrown after all the other calls
+    //! have finished.
+    //!
+    //! \param[in] count Number of indices.
+    //! \param[in] fun Functor that will be called with each index. Must be
+    //!                assignable to a ``std::function<void(std::size_t)>``.
+    void run(std::size_t count, std::function<void(std::size_t)> const & fun)
+    {
+        if(count == 0)
+            return;
+
+        start_threads();
+
+        {
+            std::lock_guard<std::mutex> const lock { mutex_ };
+            job_ = &fun;
+            count_ = count;
+            chunk_ = std::max<std::size_t>(1, count / ((threads_.size() + 1) * 4));
+            next_.store(0);
+            busy_ = threads_.size();
+            error_ = nullptr;
+            ++generation_;
+        }
+
+        wake_.notify_all();
+        process();
+
+        std::unique_lock<std::mutex> lock { mutex_ };
+        done_.wait(lock, [&]() { return busy_ == 0; });
+        job_ = nullptr;
+
+        if(error_)
+            std::rethrow_exception(error_);
+    }
+
+    //! Destructor. Stops and joins all worker threads.
+    ~work_pool()
+    {
+        {
+            std::lock_guard<std::mutex> const lock { mutex_ };
+            stop_ = true;
+        }
+
+        wake_.notify_all();
+        for(auto && t : threads_)
+            t.join();
+    }
+
+public:
+    //! Work pools are not copy-constructible.
+    work_pool(work_pool const &) =delete;
+
+    //! Work pools are not copy-assignable.
+    auto operator=(work_pool const &) -> work_pool & =delete;
+
+    //! Work pools are not move-constructible.
+    work_pool(work_pool &&) =delete;
+
+    //! Work pools are not move-assignable.
+    auto operator=(work_pool &&) -> work_pool & =delete;
+
+private:
+    void start_threads()
+    {
+        if(threads_.size() == thread_count_)
+            return;
+
+        threads_.reserve(thread_count_);
+        while(threads_.size() < thread_count_)
+            threads_.emplace_back([this]() { worker(); });
+    }
+
+    void worker()
+    {
+        auto seen = std::size_t { 0 };
+        for(;;)
+        {
+            {
+                std::unique_lock<std::mutex> lock { mutex_ };
+                wake_.wait(lock, [&]() { return stop_ || generation_ != seen; });
+                if(stop_)
+                    return;
+
+                seen = generation_;
+            }
+
+            process();
+
+            std::lock_guard<std::mutex> const lock { mutex_ };
+            if(--busy_ == 0)
+                done_.notify_one();
+        }
+    }
+
+    //! Claim and run chunks of the current job until none are left.
+    void process() noexcept
+    {
+        for(;;)
+        {
+            auto const first = next_.fetch_add(chunk_);
+            if(first >= count_)
+                return;
+
+            auto const last = std::min(first + chunk_, count_);
+            try
+            {
+                for(auto i = first; i < last; ++i)
+                    (*job_)(i);
+            }
+            catch(...)
+            {
+                std::lock_guard<std::mutex> const lock { mutex_ };
+                if(!error_)
+                    error_ = std::current_exception();
+            }
+        }
+    }
+
+private:
+    std::size_t const thread_count_;
+    std::vector<std::thread> threads_;
+
+    std::mutex mutex_;
+    std::condition_variable wake_;
+    std::condition_variable done_;
+    std::size_t generation_ { 0 };
+    std::size_t busy_ { 0 };
+    bool stop_ { false };
+    std::exception_ptr error_;
+
+    // Written under the mutex before a job is announced; read-only while the
+    // job runs.
+    std::function<void(std::size_t)> const * job_ { nullptr };
+    std::size_t count_ { 0 };
+    std::size_t chunk_ { 1 };
+    std::atomic<std::size_t> next_ { 0 };
+};
+
+} }
@@ -82,6 +82,9 @@ private:
 
     template <typename ValueType, typename UpdaterType>
     friend class expression;
+
+    template <typename Node, typename UpdaterType>
+    friend class fused_expression;
 };
 
 //! Expressions manage expression tree evaluation and results.
@@ -120,8 +123,26 @@ public:
     //! is up-to-date.
     void eval()
     {
-        root_.eval();
-        value_notifier_(root_.get());
+        eval_tree();
+        publish();
+    }
+
+    //! Evaluate the expression tree without notifying the updated value.
+    //!
+    //! Together with publish(), this allows evaluating the tree and publishing
+    //! its result in separate steps, like eval() does in a single one.
+    void eval_tree() { root_.eval(); }
+
+    //! Notify the updated value of the tree's last evaluated result.
+    void publish() { value_notifier_(root_.get()); }
+
+    //! Subscribe to change notifications from the expression tree.
+    //!
+    //! The observer is called whenever a value contained in the tree changes.
+    template <typename Observer>
+    auto subscribe_to_changes(Observer && callable)
+    {
+        return root_.subscribe(std::forward<Observer>(callable));
     }
 
     //! Retrieve the expression's result.
@@ -0,0 +1,529 @@
+#pragma once
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <initializer_list>
+#include <memory>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
+#include <observable/observe.hpp>
+#include <observable/subject.hpp>
+#include <observable/subscription.hpp>
+#include <observable/value.hpp>
+#include <observable/expressions/expression.hpp>
+#include <observable/expressions/utility.hpp>
+
+namespace observable { inline namespace expr {
+
+//! \cond
+namespace fused_detail {
+
+//! Mask with one bit set for every observable value that a node depends on.
+using mask_type = std::uint64_t;
+
+constexpr auto sum(std::initializer_list<std::size_t> values) -> std::size_t
+{
+    std::size_t s = 0;
+    for(auto v : values)
+        s += v;
+    return s;
+}
+
+//! Leaf holding a constant.
+template <typename ValueType>
+struct constant_leaf
+{
+    using result_type = ValueType;
+    static constexpr std::size_t leaf_count = 0;
+
+    template <typename Binder>
+    void bind(Binder &) { }
+
+    void eval(mask_type, bool) { }
+
+    auto get() const noexcept -> ValueType const & { return result; }
+
+    ValueType result;
+    mask_type mask = 0;
+};
+
+//! Leaf reading an observable value.
+template <typename ValueType>
+struct value_leaf
+{
+    using result_type = ValueType;
+    static constexpr std::size_t leaf_count = 1;
+
+    explicit value_leaf(value<ValueType> & v) : source { &v }, result { v.get() }
+    { }
+
+    template <typename Binder>
+    void bind(Binder & binder) { mask = binder.add_leaf(*this); }
+
+    void eval(mask_type dirty, bool force)
+    {
+        if(source && (force || (dirty & mask)))
+            result = source->get();
+    }
+
+    auto get() const noexcept -> ValueType const & { return result; }
+
+    value<ValueType> * source;
+    ValueType result;
+    mask_type mask = 0;
+};
+
+//! Inner node applying an n-ary operation to its children.
+template <typename Op, typename ... Children>
+struct op_node
+{
+    using result_type = std::decay_t<
+                            std::result_of_t<
+                                Op(typename Children::result_type const & ...)>>;
+    static constexpr std::size_t leaf_count = sum({ std::size_t { 0 },
+                                                    Children::leaf_count ... });
+
+    op_node(Op o, Children ... c) : op { std::move(o) }, children { std::move(c) ... }
+    { }
+
+    template <typename Binder>
+    void bind(Binder & binder)
+    {
+        bind_children(binder, std::index_sequence_for<Children ...> { });
+    }
+
+    void eval(mask_type dirty, bool force)
+    {
+        if(!force && !(dirty & mask))
+            return;
+
+        eval_children(dirty, force, std::index_sequence_for<Children ...> { });
+    }
+
+    auto get() const noexcept -> result_type const & { return result; }
+
+    Op op;
+    std::tuple<Children ...> children;
+    result_type result { };
+    mask_type mask = 0;
+
+private:
+    template <typename Binder, std::size_t ... I>
+    void bind_children(Binder & binder, std::index_sequence<I ...>)
+    {
+        (void)std::initializer_list<int> { (std::get<I>(children).bind(binder), 0) ... };
+        (void)std::initializer_list<int> { (mask |= std::get<I>(children).mask, 0) ... };
+    }
+
+    template <std::size_t ... I>
+    void eval_children(mask_type dirty, bool force, std::index_sequence<I ...>)
+    {
+        (void)std::initializer_list<int> { (std::get<I>(children).eval(dirty, force), 0) ... };
+        result = op(std::get<I>(children).get() ...);
+    }
+};
+
+}
+//! \endcond
+
+//! Statically-typed expression tree.
+//!
+//! Unlike expression_node, the whole tree is a single template type. It is
+//! stored inline, in one object, and evaluates as one function that the
+//! compiler can inline, without any type-erased calls.
+//!
+//! Every observable value the tree depends on is assigned one bit of a single
+//! dirty mask. Evaluating the tree only re-reads the values whose bits are set,
+//! and only recomputes the sub-trees that depend on them.
+//!
+//! Create fused trees by passing an observable value to fuse() and combining
+//! the result with the usual operators, or with fuse_op() for custom
+//! operations. Pass the tree to observe() to get an observable value:
+//!
+//!     auto result = observe(fuse(a) * b + c);
+//!
+//! \note A fused tree can depend on at most 64 observable values. Use
+//!       expression_node for larger or dynamically built trees.
+//!
+//! \tparam Node Type of the tree's root node.
+//! \ingroup observable_expressions
+template <typename Node>
+class fused_expr
+{
+public:
+    //! Type of the tree's root node.
+    using node_type = Node;
+
+    //! Type of the value computed by the tree.
+    using result_type = typename Node::result_type;
+
+    //! Create a fused tree from its root node.
+    explicit fused_expr(Node root) : root_ { std::move(root) } { }
+
+    //! Take the tree's root node.
+    auto release() && -> Node { return std::move(root_); }
+
+private:
+    Node root_;
+};
+
+//! \cond
+namespace fused_detail {
+
+template <typename T>
+struct is_fused_ : std::false_type { };
+
+template <typename Node>
+struct is_fused_<fused_expr<Node>> : std::true_type { };
+
+template <typename T>
+struct is_fused : is_fused_<std::decay_t<T>> { };
+
+template <typename ... T>
+struct any_fused : std::false_type { };
+
+template <typename H, typename ... T>
+struct any_fused<H, T ...> :
+    std::integral_constant<bool, is_fused<H>::value || any_fused<T ...>::value>
+{ };
+
+template <typename ... T>
+struct any_dynamic : std::false_type { };
+
+template <typename H, typename ... T>
+struct any_dynamic<H, T ...> :
+    std::integral_constant<bool, is_expression_node<H>::value ||
+                                 any_dynamic<T ...>::value>
+{ };
+
+//! Convert an operand to a fused node.
+template <typename ValueType, typename ... R>
+inline auto to_node(value<ValueType, R ...> & v)
+{
+    return value_leaf<ValueType> { v };
+}
+
+template <typename Node>
+inline auto to_node(fused_expr<Node> && e)
+{
+    return std::move(e).release();
+}
+
+template <typename T>
+inline auto to_node(T && constant)
+    -> std::enable_if_t<!is_value<T>::value && !is_fused<T>::value,
+                        constant_leaf<std::decay_t<T>>>
+{
+    return constant_leaf<std::decay_t<T>> { std::forward<T>(constant) };
+}
+
+template <typename T>
+using node_t = decltype(to_node(std::declval<T>()));
+
+template <typename Op, typename ... Args>
+using op_node_t = op_node<std::decay_t<Op>, node_t<Args> ...>;
+
+}
+//! \endcond
+
+//! Start a fused expression tree from an observable value.
+//!
+//! \param[in] v Value that the tree will depend on.
+//! \return A fused tree evaluating to the value's current value.
+//!
+//! \ingroup observable_expressions
+template <typename ValueType, typename ... R>
+inline auto fuse(value<ValueType, R ...> & v)
+{
+    return fused_expr<fused_detail::value_leaf<ValueType>> { fused_detail::to_node(v) };
+}
+
+//! Create a fused tree node from an n-ary operation.
+//!
+//! \param[in] op Operation that will be applied to the operands' results.
+//! \param[in] args ... Operands. These can be fused trees, observable values
+//!                     or constants. At least one of them must be a fused tree
+//!                     or an observable value.
+//! \return A fused tree evaluating to ``op(args ...)``.
+//!
+//! \ingroup observable_expressions
+template <typename Op, typename ... Args>
+inline auto fuse_op(Op && op, Args && ... args)
+    -> std::enable_if_t<(fused_detail::any_fused<Args ...>::value ||
+                         expr_detail::are_any_observable<Args ...>::value) &&
+                        !fused_detail::any_dynamic<Args ...>::value,
+                        fused_expr<fused_detail::op_node_t<Op, Args ...>>>
+{
+    using node_type = fused_detail::op_node_t<Op, Args ...>;
+    return fused_expr<node_type> {
+        node_type { std::forward<Op>(op), fused_detail::to_node(std::forward<Args>(args)) ... }
+    };
+}
+
+//! Create a unary operator for fused trees.
+//!
+//! \ingroup observable_detail
+#define OBSERVABLE_DEFINE_FUSED_UNARY_OP(NAME, OP) \
+namespace fused_detail { \
+struct NAME \
+{ \
+    template <typename T> \
+    auto operator()(T const & v) const { return (OP v); } \
+}; \
+} \
+\
+template <typename Node> \
+inline auto operator OP (fused_expr<Node> && arg) \
+{ \
+    return fuse_op(fused_detail::NAME { }, std::move(arg)); \
+}
+
+//! Create a binary operator for fused trees.
+//!
+//! Either operand can be a fused tree, an observable value or a constant, as
+//! long as at least one of them is a fused tree.
+//!
+//! \ingroup observable_detail
+#define OBSERVABLE_DEFINE_FUSED_BINARY_OP(NAME, OP) \
+namespace fused_detail { \
+struct NAME \
+{ \
+    template <typename A, typename B> \
+    auto operator()(A const & a, B const & b) const { return (a OP b); } \
+}; \
+} \
+\
+template <typename A, typename B> \
+inline auto operator OP (A && a, B && b) \
+    -> std::enable_if_t<fused_detail::any_fused<A, B>::value && \
+                        !fused_detail::any_dynamic<A, B>::value, \
+                        fused_expr<fused_detail::op_node_t<fused_detail::NAME, A, B>>> \
+{ \
+    return fuse_op(fused_detail::NAME { }, std::forward<A>(a), std::forward<B>(b)); \
+}
+
+// Unary operators.
+
+OBSERVABLE_DEFINE_FUSED_UNARY_OP(not_, !)
+OBSERVABLE_DEFINE_FUSED_UNARY_OP(bit_not_, ~)
+OBSERVABLE_DEFINE_FUSED_UNARY_OP(plus_, +)
+OBSERVABLE_DEFINE_FUSED_UNARY_OP(negate_, -)
+
+// Binary operators.
+
+OBSERVABLE_DEFINE_FUSED_BINARY_OP(mul_, *)
+OBSERVABLE_DEFINE_FUSED_BINARY_OP(div_, /)
+OBSERVABLE_DEFINE_FUSED_BINARY_OP(mod_, %)
+OBSERVABLE_DEFINE_FUSED_BINARY_OP(add_, +)
+OBSERVABLE_DEFINE_FUSED_BINARY_OP(sub_, -)
+OBSERVABLE_DEFINE_FUSED_BINARY_OP(shl_, <<)
+OBSERVABLE_DEFINE_FUSED_BINARY_OP(shr_, >>)
+OBSERVABLE_DEFINE_FUSED_BINARY_OP(less_, <)
+OBSERVABLE_DEFINE_FUSED_BINARY_OP(less_equal_, <=)
+OBSERVABLE_DEFINE_FUSED_BINARY_OP(greater_, >)
+OBSERVABLE_DEFINE_FUSED_BINARY_OP(greater_equal_, >=)
+OBSERVABLE_DEFINE_FUSED_BINARY_OP(equal_, ==)
+OBSERVABLE_DEFINE_FUSED_BINARY_OP(not_equal_, !=)
+OBSERVABLE_DEFINE_FUSED_BINARY_OP(bit_and_, &)
+OBSERVABLE_DEFINE_FUSED_BINARY_OP(bit_xor_, ^)
+OBSERVABLE_DEFINE_FUSED_BINARY_OP(bit_or_, |)
+OBSERVABLE_DEFINE_FUSED_BINARY_OP(and_, &&)
+OBSERVABLE_DEFINE_FUSED_BINARY_OP(or_, ||)
+
+//! Expression that owns and evaluates a fused tree.
+//!
+//! This is the fused counterpart of expression; it updates a value when the
+//! tree changes.
+//!
+//! \tparam Node Type of the tree's root node.
+//! \tparam EvaluatorType An instance of expression_evaluator, or a type derived
+//!                       from it.
+//! \warning None of the methods in this class can be safely called concurrently.
+//!
+//! \ingroup observable_detail
+template <typename Node, typename EvaluatorType=expression_evaluator>
+class fused_expression : public value_updater<typename Node::result_type>
+{
+    static_assert(std::is_base_of<expression_evaluator, EvaluatorType>::value,
+                  "EvaluatorType needs to be derived from expression_evaluator.");
+
+    static_assert(Node::leaf_count <= 64,
+                  "Fused trees can depend on at most 64 observable values.");
+
+    using result_type = typename Node::result_type;
+
+public:
+    //! Create a new expression from a fused tree.
+    //!
+    //! \param[in] root Fused tree root node.
+    //! \param[in] evaluator Expression evaluator to be used for globally updating
+    //!                      the expression.
+    fused_expression(Node root, EvaluatorType const & evaluator) :
+        root_ { std::move(root) },
+        evaluator_ { evaluator }
+    {
+        root_.bind(*this);
+        root_.eval(0, true);
+
+        // Immediate expressions are evaluated from their leaves' observers;
+        // there is nothing to gain from registering them.
+        if(!is_immediate)
+            expression_id_ = evaluator_.insert(this);
+    }
+
+    //! Evaluate the tree, if any of its values have changed, and notify the
+    //! updated value.
+    void eval()
+    {
+        if(!dirty_)
+            return;
+
+        eval_tree();
+        publish();
+    }
+
+    //! Evaluate the tree, if any of its values have changed, without notifying
+    //! the updated value.
+    void eval_tree()
+    {
+        auto const dirty = dirty_;
+        if(!dirty)
+            return;
+
+        dirty_ = 0;
+        root_.eval(dirty, false);
+    }
+
+    //! Notify the updated value of the tree's last evaluated result.
+    void publish() { value_notifier_(result_type { root_.get() }); }
+
+    //! Subscribe to change notifications from the tree.
+    //!
+    //! The observer is called whenever a value contained in the tree changes.
+    //! Immediate expressions never call it.
+    template <typename Observer>
+    auto subscribe_to_changes(Observer && callable)
+    {
+        return changed_.subscribe(std::forward<Observer>(callable));
+    }
+
+    virtual auto get() const -> result_type override { return root_.get(); }
+
+    virtual void set_value_notifier(std::function<void(result_type &&)> const & notifier) override
+    {
+        value_notifier_ = notifier;
+    }
+
+    //! Destructor.
+    virtual ~fused_expression()
+    {
+        if(!is_immediate)
+            evaluator_.remove(expression_id_);
+    }
+
+    //! Internal: Assign a dirty bit to a value leaf and start tracking its
+    //! value. Called by the leaves while binding the tree.
+    template <typename ValueType>
+    auto add_leaf(fused_detail::value_leaf<ValueType> & leaf) -> fused_detail::mask_type
+    {
+        assert(next_bit_ < 64);
+        auto const bit = fused_detail::mask_type { 1 } << next_bit_++;
+        auto & source = *leaf.source;
+
+        subs_.emplace_back(source.subscribe([this, bit]() { mark_dirty(bit); }));
+
+        subs_.emplace_back(source.moved.subscribe([l = &leaf](auto & v) {
+            l->source = &v;
+        }));
+
+        subs_.emplace_back(source.destroyed.subscribe([l = &leaf]() {
+            l->source = nullptr;
+        }));
+
+        return bit;
+    }
+
+public:
+    //! Fused expressions are not copy-constructible.
+    fused_expression(fused_expression const &) =delete;
+
+    //! Fused expressions are not copy-assignable.
+    auto operator=(fused_expression const &) -> fused_expression & =delete;
+
+    //! Fused expressions are not move-constructible; leaves are tracked by
+    //! address.
+    fused_expression(fused_expression &&) =delete;
+
+    //! Fused expressions are not move-assignable.
+    auto operator=(fused_expression &&) -> fused_expression & =delete;
+
+private:
+    void mark_dirty(fused_detail::mask_type bit)
+    {
+        dirty_ |= bit;
+        if(is_immediate)
+            eval();
+        else
+            changed_.notify();
+    }
+
+    static constexpr bool is_immediate = std::is_same<EvaluatorType,
+                                                      immediate_evaluator>::value;
+
+    Node root_;
+    EvaluatorType evaluator_;
+    typename EvaluatorType::id expression_id_ { };
+    fused_detail::mask_type dirty_ = 0;
+    unsigned next_bit_ = 0;
+    std::vector<unique_subscription> subs_;
+    subject<void()> changed_;
+    std::function<void(result_type &&)> value_notifier_ { [](auto &&) { } };
+};
+
+//! Observe changes to a fused tree with automatic evaluation.
+//!
+//! Returns a value that is updated whenever any value in the tree changes.
+//!
+//! \param[in] root Fused tree to observe.
+//! \return An observable value that is automatically updated when the provided
+//!         tree changes.
+//!
+//! \ingroup observable
+template <typename Node>
+inline auto observe(fused_expr<Node> && root)
+{
+    using value_type = typename Node::result_type;
+    using expression_type = fused_expression<Node, immediate_evaluator>;
+    auto e = std::make_unique<expression_type>(std::move(root).release(),
+                                               immediate_evaluator { });
+    return value<value_type> { std::move(e) };
+}
+
+//! Observe changes to a fused tree with manual synchronization.
+//!
+//! Returns an observable value that is updated when the ``update()`` method is
+//! called on the provided \ref updater, if any value in the tree has changed
+//! since the last update.
+//!
+//! \param[in] ud An \ref updater instance to be used for manually updating the
+//!               returned value with the fused tree.
+//! \param[in] root A fused tree to be used for updating the returned value.
+//! \return An observable value that is updated from the provided tree.
+//!
+//! \ingroup observable
+template <typename UpdaterType, typename Node>
+inline auto observe(UpdaterType & ud, fused_expr<Node> && root)
+{
+    static_assert(std::is_base_of<updater, UpdaterType>::value,
+                  "UpdaterType must derive from updater.");
+
+    using value_type = typename Node::result_type;
+    using expression_type = fused_expression<Node, UpdaterType>;
+    auto e = std::make_unique<expression_type>(std::move(root).release(), ud);
+    return value<value_type> { std::move(e) };
+}
+
+} }
@@ -0,0 +1,489 @@
+#pragma once
+#include <algorithm>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <type_traits>
+#include <utility>
+#include <vector>
+#include <observable/observe.hpp>
+#include <observable/subscription.hpp>
+#include <observable/timer.hpp>
+#include <observable/value.hpp>
+#include <observable/expressions/tree.hpp>
+
+namespace observable { inline namespace expr {
+
+//! \cond
+namespace timing_detail {
+
+//! State shared between a timed updater and the tasks it has scheduled.
+//!
+//! Scheduled tasks only hold a weak reference to the state, so tasks that run
+//! after the owning value has been destroyed do nothing.
+template <typename InputType, typename OutputType>
+struct state_base
+{
+    using input_type = InputType;
+    using output_type = OutputType;
+
+    state_base(timer_source & t, OutputType initial) :
+        timer { t },
+        current { std::move(initial) }
+    { }
+
+    //! Publish a new output value. Must be called without holding the mutex.
+    void emit(OutputType v)
+    {
+        std::function<void(OutputType &&)> n;
+        {
+            std::lock_guard<std::mutex> const lock { mutex };
+            current = v;
+            n = notifier;
+        }
+
+        n(std::move(v));
+    }
+
+    timer_source & timer;
+    std::mutex mutex;
+    OutputType current;
+    std::function<void(OutputType &&)> notifier { [](auto &&) { } };
+};
+
+//! Schedule a call to ``State::fire()`` that is skipped if the state is gone.
+template <typename State>
+inline void schedule_fire(std::shared_ptr<State> const & s, timer_source::duration delay)
+{
+    s->timer.schedule(delay, [w = std::weak_ptr<State> { s }]() {
+        if(auto const p = w.lock())
+            p->fire(p);
+    });
+}
+
+template <typename ValueType>
+struct throttle_state : state_base<ValueType, ValueType>
+{
+    throttle_state(timer_source & t, ValueType initial, timer_source::duration i) :
+        state_base<ValueType, ValueType>(t, std::move(initial)),
+        interval { i },
+        last_emit { t.now() - i }
+    { }
+
+    void push(std::shared_ptr<throttle_state> const & self, ValueType const & v)
+    {
+        std::unique_lock<std::mutex> lock { this->mutex };
+        latest = v;
+        pending = true;
+        if(scheduled)
+            return;
+
+        scheduled = true;
+        auto const delay = std::max(last_emit + interval - this->timer.now(),
+                                    timer_source::duration::zero());
+        lock.unlock();
+        schedule_fire(self, delay);
+    }
+
+    void fire(std::shared_ptr<throttle_state> const &)
+    {
+        std::unique_lock<std::mutex> lock { this->mutex };
+        scheduled = false;
+        if(!pending)
+            return;
+
+        pending = false;
+        last_emit = this->timer.now();
+        auto v = latest;
+        lock.unlock();
+        this->emit(std::move(v));
+    }
+
+    timer_source::duration const interval;
+    timer_source::time_point last_emit;
+    ValueType latest { };
+    bool pending = false;
+    bool scheduled = false;
+};
+
+template <typename ValueType>
+struct debounce_state : state_base<ValueType, ValueType>
+{
+    debounce_state(timer_source & t, ValueType initial, timer_source::duration q) :
+        state_base<ValueType, ValueType>(t, std::move(initial)),
+        quiet { q }
+    { }
+
+    void push(std::shared_ptr<debounce_state> const & self, ValueType const & v)
+    {
+        std::unique_lock<std::mutex> lock { this->mutex };
+        latest = v;
+        pending = true;
+        last_change = this->timer.now();
+        if(scheduled)
+            return;
+
+        scheduled = true;
+        lock.unlock();
+        schedule_fire(self, quiet);
+    }
+
+    void fire(std::shared_ptr<debounce_state> const & self)
+    {
+        std::unique_lock<std::mutex> lock { this->mutex };
+        scheduled = false;
+        if(!pending)
+            return;
+
+        // Changes that arrived while we were waiting push the deadline back;
+        // wait for the rest of the quiet period instead of scheduling a task
+        // for each change.
+        auto const remaining = last_change + quiet - this->timer.now();
+        if(remaining > timer_source::duration::zero())
+        {
+            scheduled = true;
+            lock.unlock();
+            schedule_fire(self, remaining);
+            return;
+        }
+
+        pending = false;
+        auto v = latest;
+        lock.unlock();
+        this->emit(std::move(v));
+    }
+
+    timer_source::duration const quiet;
+    timer_source::time_point last_change;
+    ValueType latest { };
+    bool pending = false;
+    bool scheduled = false;
+};
+
+template <typename ValueType>
+struct sample_state : state_base<ValueType, ValueType>
+{
+    sample_state(timer_source & t, ValueType initial, timer_source::duration p) :
+        state_base<ValueType, ValueType>(t, std::move(initial)),
+        period { p },
+        next_due { t.now() + p }
+    { }
+
+    void push(std::shared_ptr<sample_state> const &, ValueType const & v)
+    {
+        std::lock_guard<std::mutex> const lock { this->mutex };
+        latest = v;
+        pending = true;
+    }
+
+    void fire(std::shared_ptr<sample_state> const & self)
+    {
+        std::unique_lock<std::mutex> lock { this->mutex };
+
+        // Keep the sampling grid fixed, even if the timer runs late.
+        auto const now = this->timer.now();
+        do
+            next_due += period;
+        while(next_due <= now);
+
+        auto const emit_now = pending;
+        pending = false;
+        auto v = latest;
+        auto const delay = next_due - now;
+        lock.unlock();
+
+        schedule_fire(self, delay);
+        if(emit_now)
+            this->emit(std::move(v));
+    }
+
+    timer_source::duration const period;
+    timer_source::time_point next_due;
+    ValueType latest { };
+    bool pending = false;
+};
+
+template <typename ValueType>
+struct buffer_state : state_base<ValueType, std::vector<ValueType>>
+{
+    buffer_state(timer_source & t, timer_source::duration w) :
+        state_base<ValueType, std::vector<ValueType>>(t, { }),
+        window { w }
+    { }
+
+    void push(std::shared_ptr<buffer_state> const & self, ValueType const & v)
+    {
+        std::unique_lock<std::mutex> lock { this->mutex };
+        buffer.push_back(v);
+        if(scheduled)
+            return;
+
+        scheduled = true;
+        lock.unlock();
+        schedule_fire(self, window);
+    }
+
+    void fire(std::shared_ptr<buffer_state> const &)
+    {
+        std::unique_lock<std::mutex> lock { this->mutex };
+        scheduled = false;
+        std::vector<ValueType> v;
+        v.swap(buffer);
+        lock.unlock();
+
+        if(!v.empty())
+            this->emit(std::move(v));
+    }
+
+    timer_source::duration const window;
+    std::vector<ValueType> buffer;
+    bool scheduled = false;
+};
+
+//! Value updater that forwards source changes to a timing state.
+template <typename State>
+class timed_updater final : public value_updater<typename State::output_type>
+{
+    using input_type = typename State::input_type;
+    using output_type = typename State::output_type;
+
+public:
+    template <typename ... T>
+    timed_updater(std::shared_ptr<State> state, value<T ...> & source) :
+        state_ { std::move(state) },
+        sub_ { source.subscribe([w = std::weak_ptr<State> { state_ }](input_type const & v) {
+                   if(auto const s = w.lock())
+                       s->push(s, v);
+               }) }
+    { }
+
+    timed_updater(std::shared_ptr<State> state,
+                  std::unique_ptr<value<input_type>> source) :
+        timed_updater(std::move(state), *source)
+    {
+        owned_source_ = std::move(source);
+    }
+
+    virtual void set_value_notifier(std::function<void(output_type &&)> const & notifier) override
+    {
+        std::lock_guard<std::mutex> const lock { state_->mutex };
+        state_->notifier = notifier;
+    }
+
+    virtual auto get() const -> output_type override
+    {
+        std::lock_guard<std::mutex> const lock { state_->mutex };
+        return state_->current;
+    }
+
+    virtual ~timed_updater()
+    {
+        sub_.unsubscribe();
+        std::lock_guard<std::mutex> const lock { state_->mutex };
+        state_->notifier = [](auto &&) { };
+    }
+
+private:
+    std::shared_ptr<State> state_;
+    std::unique_ptr<value<input_type>> owned_source_;
+    unique_subscription sub_;
+};
+
+template <typename State, typename Source, typename ... StateArgs>
+inline auto make_timed_updater(Source & source, timer_source & timer, StateArgs && ... args)
+{
+    auto s = std::make_shared<State>(timer, std::forward<StateArgs>(args) ...);
+    return std::make_unique<timed_updater<State>>(std::move(s), source);
+}
+
+template <typename ValueType>
+inline auto own(expression_node<ValueType> && node)
+{
+    return std::make_unique<value<ValueType>>(observe(std::move(node)));
+}
+
+//! Comparator that treats all values as different.
+struct never_equal
+{
+    template <typename A, typename B>
+    auto operator()(A const &, B const &) const noexcept { return false; }
+};
+
+}
+//! \endcond
+
+//! Limit how often a value can change.
+//!
+//! Returns a value that follows the source, but changes at most once every
+//! ``interval``. The first change is forwarded as soon as possible; changes
+//! that arrive faster than that are collapsed, and only the latest one is
+//! forwarded once the interval has elapsed.
+//!
+//! \param[in] source Value to throttle. The returned value will stop following
+//!                   it once it is destroyed.
+//! \param[in] interval Minimum amount of time between two changes.
+//! \param[in] timer Timer source used for scheduling changes. It must outlive
+//!                  the returned value.
+//! \return A value that follows the source at a limited rate.
+//!
+//! \note The returned value is only changed from tasks run by the timer source,
+//!       so its observers are called on the timer's thread.
+//!
+//! \ingroup observable_expressions
+template <typename ... T>
+inline auto throttle(value<T ...> & source,
+                     timer_source::duration interval,
+                     timer_source & timer)
+{
+    using value_type = std::decay_t<decltype(source.get())>;
+    using state = timing_detail::throttle_state<value_type>;
+    return value<value_type> {
+        timing_detail::make_timed_updater<state>(source, timer, source.get(), interval)
+    };
+}
+
+//! \overload
+template <typename ValueType>
+inline auto throttle(expression_node<ValueType> && source,
+                     timer_source::duration interval,
+                     timer_source & timer)
+{
+    using state = timing_detail::throttle_state<ValueType>;
+    auto v = timing_detail::own(std::move(source));
+    auto s = std::make_shared<state>(timer, v->get(), interval);
+    return value<ValueType> {
+        std::make_unique<timing_detail::timed_updater<state>>(std::move(s), std::move(v))
+    };
+}
+
+//! Wait for a value to settle before following it.
+//!
+//! Returns a value that changes to the source's latest value once the source
+//! has not changed for at least ``quiet``.
+//!
+//! \param[in] source Value to debounce.
+//! \param[in] quiet Amount of time the source needs to stay unchanged.
+//! \param[in] timer Timer source used for scheduling changes. It must outlive
+//!                  the returned value.
+//! \return A value that follows the source once it has settled.
+//!
+//! \note The returned value is only changed from tasks run by the timer source,
+//!       so its observers are called on the timer's thread.
+//!
+//! \ingroup observable_expressions
+template <typename ... T>
+inline auto debounce(value<T ...> & source,
+                     timer_source::duration quiet,
+                     timer_source & timer)
+{
+    using value_type = std::decay_t<decltype(source.get())>;
+    using state = timing_detail::debounce_state<value_type>;
+    return value<value_type> {
+        timing_detail::make_timed_updater<state>(source, timer, source.get(), quiet)
+    };
+}
+
+//! \overload
+template <typename ValueType>
+inline auto debounce(expression_node<ValueType> && source,
+                     timer_source::duration quiet,
+                     timer_source & timer)
+{
+    using state = timing_detail::debounce_state<ValueType>;
+    auto v = timing_detail::own(std::move(source));
+    auto s = std::make_shared<state>(timer, v->get(), quiet);
+    return value<ValueType> {
+        std::make_unique<timing_detail::timed_updater<state>>(std::move(s), std::move(v))
+    };
+}
+
+//! Follow a value at a fixed rate.
+//!
+//! Returns a value that, every ``period``, changes to the source's latest value
+//! if the source changed since the previous period.
+//!
+//! \param[in] source Value to sample.
+//! \param[in] period Sampling period.
+//! \param[in] timer Timer source used for scheduling samples. It must outlive
+//!                  the returned value.
+//! \return A value that follows the source at a fixed rate.
+//!
+//! \note The returned value keeps a task scheduled on the timer source for as
+//!       long as it is alive.
+//!
+//! \ingroup observable_expressions
+template <typename ... T>
+inline auto sample_every(value<T ...> & source,
+                         timer_source::duration period,
+                         timer_source & timer)
+{
+    using value_type = std::decay_t<decltype(source.get())>;
+    using state = timing_detail::sample_state<value_type>;
+    auto s = std::make_shared<state>(timer, source.get(), period);
+    timing_detail::schedule_fire(s, period);
+    return value<value_type> {
+        std::make_unique<timing_detail::timed_updater<state>>(std::move(s), source)
+    };
+}
+
+//! \overload
+template <typename ValueType>
+inline auto sample_every(expression_node<ValueType> && source,
+                         timer_source::duration period,
+                         timer_source & timer)
+{
+    using state = timing_detail::sample_state<ValueType>;
+    auto v = timing_detail::own(std::move(source));
+    auto s = std::make_shared<state>(timer, v->get(), period);
+    timing_detail::schedule_fire(s, period);
+    return value<ValueType> {
+        std::make_unique<timing_detail::timed_updater<state>>(std::move(s), std::move(v))
+    };
+}
+
+//! Collect changes to a value into batches.
+//!
+//! Returns a value holding all the source values received during a window of
+//! ``window`` duration. A window is opened by the first change received after
+//! the previous window closed, so no tasks are scheduled while the source is
+//! idle.
+//!
+//! \param[in] source Value to buffer.
+//! \param[in] window Duration of each batching window.
+//! \param[in] timer Timer source used for closing windows. It must outlive the
+//!                  returned value.
+//! \return A value holding a ``std::vector`` with the latest batch. Observers
+//!         are notified for every batch, even if it compares equal to the
+//!         previous one.
+//!
+//! \ingroup observable_expressions
+template <typename ... T>
+inline auto buffer_for(value<T ...> & source,
+                       timer_source::duration window,
+                       timer_source & timer)
+{
+    using value_type = std::decay_t<decltype(source.get())>;
+    using state = timing_detail::buffer_state<value_type>;
+    return value<std::vector<value_type>> {
+        timing_detail::make_timed_updater<state>(source, timer, window),
+        timing_detail::never_equal { }
+    };
+}
+
+//! \overload
+template <typename ValueType>
+inline auto buffer_for(expression_node<ValueType> && source,
+                       timer_source::duration window,
+                       timer_source & timer)
+{
+    using state = timing_detail::buffer_state<ValueType>;
+    auto v = timing_detail::own(std::move(source));
+    auto s = std::make_shared<state>(timer, window);
+    return value<std::vector<ValueType>> {
+        std::make_unique<timing_detail::timed_updater<state>>(std::move(s), std::move(v)),
+        timing_detail::never_equal { }
+    };
+}
+
+} }
@@ -0,0 +1,335 @@
+#pragma once
+#include <cstddef>
+#include <functional>
+#include <initializer_list>
+#include <map>
+#include <type_traits>
+#include <utility>
+#include <vector>
+#include <observable/subject.hpp>
+#include <observable/subscription.hpp>
+#include <observable/vector.hpp>
+#include <observable/detail/type_traits.hpp>
+
+namespace observable {
+
+//! Keys affected by changes to an observable \ref map.
+//!
+//! The change set describes the difference between the map as it was before the
+//! changes and as it is after them; each key appears in at most one list. Keys
+//! are sorted.
+//!
+//! \ingroup observable
+template <typename KeyType>
+struct key_change_set
+{
+    //! Keys that were added.
+    std::vector<KeyType> inserted;
+
+    //! Keys that were removed.
+    std::vector<KeyType> erased;
+
+    //! Keys whose values changed.
+    std::vector<KeyType> updated;
+
+    //! Return true if nothing changed.
+    auto empty() const noexcept
+    {
+        return inserted.empty() && erased.empty() && updated.empty();
+    }
+};
+
+//! Ordered map that notifies observers of the keys that changed.
+//!
+//! Observers receive a key_change_set instead of the whole map. Each mutation
+//! produces one change set, unless mutations are batched. All the mutations
+//! made while a batch is alive produce a single change set; changes that cancel
+//! out (inserting and then erasing a key) are not reported.
+//!
+//! \warning None of the methods in this class can be safely called concurrently.
+//!
+//! \tparam KeyType Type of the keys. Must be LessThanComparable.
+//! \tparam ValueType Type of the mapped values.
+//!
+//! \ingroup observable
+template <typename KeyType, typename ValueType>
+class map
+{
+public:
+    //! Change set type passed to observers.
+    using change_set = key_change_set<KeyType>;
+
+private:
+    using void_subject = subject<void()>;
+    using changes_subject = subject<void(change_set const &)>;
+    using container_type = std::map<KeyType, ValueType>;
+
+public:
+    //! Type of the keys.
+    using key_type = KeyType;
+
+    //! Type of the mapped values.
+    using mapped_type = ValueType;
+
+    //! Type used for sizes.
+    using size_type = std::size_t;
+
+    //! Read-only iterator.
+    using const_iterator = typename container_type::const_iterator;
+
+    //! Keep mutations batched for the duration of an instance's lifetime.
+    //!
+    //! Batches can be nested; the change set is delivered when the outermost
+    //! batch is destroyed.
+    class batch_guard
+    {
+    public:
+        explicit batch_guard(map<KeyType, ValueType> & m) noexcept : map_ { &m }
+        {
+            ++map_->batch_depth_;
+        }
+
+        ~batch_guard()
+        {
+            if(map_ && --map_->batch_depth_ == 0)
+                map_->flush();
+        }
+
+        batch_guard(batch_guard const &) =delete;
+        auto operator=(batch_guard const &) -> batch_guard & =delete;
+
+        batch_guard(batch_guard && other) noexcept : map_ { other.map_ }
+        {
+            other.map_ = nullptr;
+        }
+
+        auto operator=(batch_guard &&) -> batch_guard & =delete;
+
+    private:
+        map<KeyType, ValueType> * map_;
+    };
+
+public:
+    //! Create an empty map.
+    map() =default;
+
+    //! Create a map with the provided elements.
+    map(std::initializer_list<std::pair<KeyType const, ValueType>> initial) :
+        items_ { initial }
+    { }
+
+    //! Retrieve the stored elements.
+    auto get() const noexcept -> container_type const & { return items_; }
+
+    //! Return the number of elements.
+    auto size() const noexcept { return items_.size(); }
+
+    //! Return true if the map has no elements.
+    auto empty() const noexcept { return items_.empty(); }
+
+    //! Return 1 if the key is present, 0 otherwise.
+    auto count(KeyType const & key) const { return items_.count(key); }
+
+    //! Find the element with the provided key.
+    auto find(KeyType const & key) const { return items_.find(key); }
+
+    //! Retrieve the value mapped to a key, with bounds checking.
+    auto at(KeyType const & key) const -> ValueType const & { return items_.at(key); }
+
+    //! Return an iterator to the first element.
+    auto begin() const noexcept { return items_.cbegin(); }
+
+    //! Return an iterator past the last element.
+    auto end() const noexcept { return items_.cend(); }
+
+    //! Subscribe to changes to the map.
+    //!
+    //! \param[in] observer A callable that will be called after the map
+    //!                     changes.
+    //!
+    //! \tparam Callable A callable taking no parameters, or a callable taking
+    //!                  a ``change_set const &``.
+    //!
+    //! \see subject<void(Args ...)>::subscribe()
+    template <typename Callable>
+    auto subscribe(Callable && observer) const
+    {
+        static_assert(detail::is_compatible_with_subject<Callable, void_subject>::value ||
+                      detail::is_compatible_with_subject<Callable, changes_subject>::value,
+                      "Observer is not valid. Please provide a void observer or an "
+                      "observer that takes a change_set as its only argument.");
+
+        return subscribe_impl(std::forward<Callable>(observer));
+    }
+
+    //! Start a batch of mutations.
+    //!
+    //! \return A guard that delivers the batched changes when destroyed.
+    auto batch() { return batch_guard { *this }; }
+
+    //! Insert an element, or assign a new value to an existing one.
+    //!
+    //! Nothing is recorded if the key exists and its value compares equal to
+    //! the new one.
+    void set(KeyType const & key, ValueType v)
+    {
+        auto const it = items_.find(key);
+        if(it == items_.end())
+        {
+            items_.emplace(key, std::move(v));
+            record(key, change_kind::inserted);
+            return;
+        }
+
+        if(equal(it->second, v))
+            return;
+
+        it->second = std::move(v);
+        record(key, change_kind::updated);
+    }
+
+    //! Modify the value mapped to an existing key in-place.
+    //!
+    //! \param[in] key Key of the element to modify.
+    //! \param[in] fun Callable that will be called with a reference to the
+    //!                value. The element is always reported as updated.
+    //! \return False if the key does not exist.
+    template <typename UnaryFunctor>
+    auto modify(KeyType const & key, UnaryFunctor && fun) -> bool
+    {
+        auto const it = items_.find(key);
+        if(it == items_.end())
+            return false;
+
+        fun(it->second);
+        record(key, change_kind::updated);
+        return true;
+    }
+
+    //! Erase the element with the provided key.
+    //!
+    //! \return Number of erased elements.
+    auto erase(KeyType const & key) -> size_type
+    {
+        if(!items_.erase(key))
+            return 0;
+
+        record(key, change_kind::erased);
+        return 1;
+    }
+
+    //! Erase all elements.
+    void clear()
+    {
+        auto const b = batch();
+        for(auto && p : items_)
+            record(p.first, change_kind::erased);
+
+        items_.clear();
+    }
+
+public:
+    //! Observable maps are **not** copy-constructible.
+    map(map const &) =delete;
+
+    //! Observable maps are **not** copy-assignable.
+    auto operator=(map const &) -> map & =delete;
+
+    //! Observable maps are move-constructible.
+    map(map &&) =default;
+
+    //! Observable maps are move-assignable.
+    auto operator=(map &&) -> map & =default;
+
+private:
+    template <typename Callable>
+    auto subscribe_impl(Callable && observer) const ->
+        std::enable_if_t<detail::is_compatible_with_subject<Callable, void_subject>::value &&
+                         !detail::is_compatible_with_subject<Callable, changes_subject>::value,
+                         infinite_subscription>
+    {
+        return void_observers_.subscribe(std::forward<Callable>(observer));
+    }
+
+    template <typename Callable>
+    auto subscribe_impl(Callable && observer) const ->
+        std::enable_if_t<detail::is_compatible_with_subject<Callable,
+                                                            changes_subject>::value,
+                         infinite_subscription>
+    {
+        return changes_observers_.subscribe(std::forward<Callable>(observer));
+    }
+
+    template <typename A>
+    static auto equal(A const & a, A const & b)
+        -> std::enable_if_t<detail::are_equality_comparable<A, A>::value, bool>
+    {
+        return a == b;
+    }
+
+    template <typename A>
+    static auto equal(A const &, A const &)
+        -> std::enable_if_t<!detail::are_equality_comparable<A, A>::value, bool>
+    {
+        return false;
+    }
+
+    //! Record a change relative to the state before the current batch, and
+    //! deliver it unless a batch is active.
+    void record(KeyType const & key, change_kind kind)
+    {
+        auto const it = pending_.find(key);
+        if(it == pending_.end())
+        {
+            pending_.emplace(key, kind);
+        }
+        else if(kind == change_kind::erased)
+        {
+            // Erasing a key inserted in this batch leaves nothing to report.
+            if(it->second == change_kind::inserted)
+                pending_.erase(it);
+            else
+                it->second = change_kind::erased;
+        }
+        else if(kind == change_kind::inserted)
+        {
+            // Re-inserting a key erased in this batch is an update.
+            it->second = change_kind::updated;
+        }
+
+        if(batch_depth_ == 0)
+            flush();
+    }
+
+    //! Deliver pending changes.
+    void flush()
+    {
+        if(pending_.empty())
+            return;
+
+        change_set changes;
+        for(auto && p : pending_)
+        {
+            switch(p.second)
+            {
+            case change_kind::inserted: changes.inserted.push_back(p.first); break;
+            case change_kind::erased: changes.erased.push_back(p.first); break;
+            case change_kind::updated: changes.updated.push_back(p.first); break;
+            }
+        }
+
+        pending_.clear();
+        void_observers_.notify();
+        changes_observers_.notify(changes);
+    }
+
+private:
+    container_type items_;
+    std::map<KeyType, change_kind> pending_;
+    std::size_t batch_depth_ = 0;
+
+    mutable void_subject void_observers_;
+    mutable changes_subject changes_observers_;
+};
+
+}
@@ -4,8 +4,14 @@
 #include <observable/subject.hpp>
 #include <observable/value.hpp>
 #include <observable/observe.hpp>
+#include <observable/parallel_updater.hpp>
+#include <observable/vector.hpp>
+#include <observable/map.hpp>
+#include <observable/timer.hpp>
 #include <observable/expressions/filters.hpp>
 #include <observable/expressions/math.hpp>
+#include <observable/expressions/fused.hpp>
+#include <observable/expressions/timing.hpp>
 
 // Some Doxygen boilerplate.
 
@@ -0,0 +1,243 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <observable/observe.hpp>
+#include <observable/expressions/fused.hpp>
+#include <observable/subscription.hpp>
+#include <observable/detail/work_pool.hpp>
+
+namespace observable {
+
+//! Updater that evaluates its expressions on multiple threads.
+//!
+//! Use this instead of a plain \ref updater when a large number of mostly
+//! independent expressions are associated with the same updater. Each
+//! update_all() call:
+//!
+//!  - evaluates only the expressions whose trees have changed since they were
+//!    last evaluated;
+//!  - evaluates the expressions that do not depend on another changed
+//!    expression in parallel, on a pool of worker threads;
+//!  - notifies the updated values on the calling thread, in the order in which
+//!    the expressions were created, after the parallel evaluation has finished;
+//!  - repeats the process for expressions that depend on values updated by the
+//!    previous step, until nothing has changed.
+//!
+//! Observers of the updated values are always called from the thread calling
+//! update_all(), in the same order, and never see a value computed from stale
+//! inputs; the results are the same as with a plain \ref updater.
+//!
+//! Dependencies between expressions are discovered while values are notified
+//! and remembered, so later updates hold back an expression while any of the
+//! expressions it depends on still has to be evaluated.
+//!
+//! \warning Expression trees associated with this updater are evaluated in
+//!          parallel, so they must not share nodes (by copying an
+//!          expression_node), and their operators must be safe to call from
+//!          multiple threads.
+//!
+//! \note Instances are cheap to copy; copies share the same expressions and
+//!       worker threads.
+//!
+//! \ingroup observable
+class parallel_updater : public updater
+{
+public:
+    //! Create an updater.
+    //!
+    //! \param[in] thread_count Number of worker threads to use, in addition to
+    //!                         the thread calling update_all(). If zero, all
+    //!                         expressions are evaluated on the calling thread.
+    //! \param[in] min_parallel_batch Expressions are only evaluated in parallel
+    //!                               if at least this many need evaluating at
+    //!                               the same time.
+    explicit parallel_updater(std::size_t thread_count = default_thread_count(),
+                              std::size_t min_parallel_batch = 32) :
+        data_ { std::make_shared<data>(thread_count, min_parallel_batch) }
+    { }
+
+    //! Update all observable values that have been associated with this
+    //! instance.
+    //!
+    //! \note This method can be safely called in parallel, from multiple threads.
+    //!       Calls are serialized.
+    //! \warning Observers of the updated values must not create or destroy
+    //!          values associated with this updater.
+    void update_all()
+    {
+        std::lock_guard<std::mutex> const lock { data_->mutex };
+        auto & d = *data_;
+
+        std::vector<entry *> batch;
+        for(;;)
+        {
+            select_ready(batch);
+            if(batch.empty())
+                break;
+
+            for(auto e : batch)
+                e->dirty.store(false);
+
+            evaluate(batch);
+
+            for(auto e : batch)
+            {
+                // An expression published earlier in this pass has changed one
+                // of this expression's inputs; its result is stale.
+                if(e->dirty.load())
+                    continue;
+
+                d.publishing = e;
+                e->publish();
+            }
+
+            d.publishing = nullptr;
+        }
+    }
+
+    //! Return the number of worker threads used when none is specified.
+    static auto default_thread_count() -> std::size_t
+    {
+        auto const n = std::thread::hardware_concurrency();
+        return n > 1 ? n - 1 : 0;
+    }
+
+private:
+    using id = void const *;
+
+    struct entry
+    {
+        id key;
+        std::function<void()> eval;
+        std::function<void()> publish;
+        std::atomic<bool> dirty { true };
+        bool blocked { false };
+        std::vector<entry *> dependents;
+        unique_subscription sub;
+    };
+
+    struct data
+    {
+        data(std::size_t thread_count, std::size_t min_parallel_batch) :
+            pool { thread_count },
+            min_batch { min_parallel_batch }
+        { }
+
+        // Kept in creation order.
+        std::vector<std::unique_ptr<entry>> entries;
+        entry * publishing { nullptr };
+        detail::work_pool pool;
+        std::size_t min_batch;
+        std::mutex mutex;
+    };
+
+    //! Register a new expression to be evaluated by this updater.
+    template <typename ExpressionType>
+    auto insert(ExpressionType * expr)
+    {
+        assert(expr);
+        std::lock_guard<std::mutex> const lock { data_->mutex };
+
+        auto e = std::make_unique<entry>();
+        e->key = expr;
+        e->eval = [=]() { expr->eval_tree(); };
+        e->publish = [=]() { expr->publish(); };
+        e->sub = expr->subscribe_to_changes([d = data_.get(), e = e.get()]() {
+                                                e->dirty.store(true);
+                                                add_dependency(d->publishing, e);
+                                            });
+
+        data_->entries.push_back(std::move(e));
+        return id { expr };
+    }
+
+    //! Unregister a previously registered expression.
+    void remove(id instance_id)
+    {
+        std::lock_guard<std::mutex> const lock { data_->mutex };
+        auto & entries = data_->entries;
+
+        auto const it = std::find_if(begin(entries),
+                                     end(entries),
+                                     [&](auto && e) { return e->key == instance_id; });
+        assert(it != end(entries));
+        if(it == end(entries))
+            return;
+
+        auto const removed = it->get();
+        for(auto && e : entries)
+        {
+            auto & deps = e->dependents;
+            deps.erase(std::remove(begin(deps), end(deps), removed), end(deps));
+        }
+
+        entries.erase(it);
+    }
+
+    //! Remember that notifying ``from``'s value changes ``to``'s tree.
+    static void add_dependency(entry * from, entry * to)
+    {
+        if(!from || from == to)
+            return;
+
+        auto & deps = from->dependents;
+        if(std::find(begin(deps), end(deps), to) == end(deps))
+            deps.push_back(to);
+    }
+
+    //! Collect the dirty expressions that do not depend on other dirty
+    //! expressions, in creation order.
+    void select_ready(std::vector<entry *> & batch) const
+    {
+        auto & entries = data_->entries;
+        batch.clear();
+
+        for(auto && e : entries)
+            e->blocked = false;
+
+        // Dependents are created after the expressions they depend on, so one
+        // pass in creation order marks every transitive dependent.
+        for(auto && e : entries)
+        {
+            auto const ready = !e->blocked && e->dirty.load();
+            if(ready)
+                batch.push_back(e.get());
+
+            if(ready || e->blocked)
+                for(auto d : e->dependents)
+                    d->blocked = true;
+        }
+    }
+
+    //! Evaluate the expression trees of a batch of expressions.
+    void evaluate(std::vector<entry *> const & batch) const
+    {
+        auto & d = *data_;
+        if(d.pool.thread_count() == 0 || batch.size() < d.min_batch)
+        {
+            for(auto e : batch)
+                e->eval();
+
+            return;
+        }
+
+        d.pool.run(batch.size(), [&](std::size_t i) { batch[i]->eval(); });
+    }
+
+    std::shared_ptr<data> data_;
+
+    template <typename ValueType, typename EvaluatorType>
+    friend class expr::expression;
+
+    template <typename Node, typename EvaluatorType>
+    friend class expr::fused_expression;
+};
+
+}
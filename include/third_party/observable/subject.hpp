@@ -4,6 +4,7 @@
 #include <memory>
 #include <type_traits>
 #include <observable/detail/collection.hpp>
+#include <observable/detail/function.hpp>
 #include <observable/detail/type_traits.hpp>
 #include <observable/subscription.hpp>
 
@@ -70,10 +71,10 @@ public:
                       " with the subject");
 
         assert(observers_);
-        auto const id = observers_->insert(observer);
+        auto const id = observers_->insert(std::forward<Callable>(observer));
 
         return infinite_subscription {
-            [this, id, weak_observers = std::weak_ptr<collection> { observers_ }]() {
+            [id, weak_observers = std::weak_ptr<collection> { observers_ }]() {
                 auto const observers = weak_observers.lock();
                 if(!observers)
                     return;
@@ -169,7 +170,7 @@ public:
     auto operator=(subject &&) noexcept -> subject & =default;
 
 private:
-    using collection = detail::collection<std::function<observer_type>>;
+    using collection = detail::collection<detail::small_function<observer_type>>;
 
     std::shared_ptr<collection> observers_ { std::make_shared<collection>() };
 };
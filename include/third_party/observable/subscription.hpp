@@ -1,7 +1,9 @@
 #pragma once
 #include <atomic>
-#include <functional>
 #include <memory>
+#include <type_traits>
+#include <utility>
+#include <observable/detail/function.hpp>
 
 namespace observable {
 
@@ -15,10 +17,14 @@ public:
     //! Create a subscription with the specified unsubscribe functor.
     //!
     //! \param[in] unsubscribe Calling this functor will unsubscribe the
-    //!                        associated observer.
+    //!                        associated observer. Small functors are stored
+    //!                        without allocating.
     //! \note This is for internal use by subject instances.
-    explicit infinite_subscription(std::function<void()> const & unsubscribe) :
-        unsubscribe_ { unsubscribe }
+    template <typename Unsubscribe, typename = std::enable_if_t<
+                                        !std::is_base_of<infinite_subscription,
+                                                         std::decay_t<Unsubscribe>>::value>>
+    explicit infinite_subscription(Unsubscribe && unsubscribe) :
+        unsubscribe_ { std::forward<Unsubscribe>(unsubscribe) }
     { }
 
     //! Unsubscribe the associated observer from receiving notifications.
@@ -28,13 +34,13 @@ public:
     //! \note If release() has been called, this method will have no effect.
     void unsubscribe()
     {
-        if(!called_ || !unsubscribe_ || called_->test_and_set())
+        if(!unsubscribe_ || called_.exchange(true))
             return;
 
         try {
-            if(unsubscribe_) unsubscribe_();
+            unsubscribe_();
         } catch(...) {
-            called_->clear();
+            called_.store(false);
             throw;
         }
     }
@@ -44,8 +50,8 @@ public:
     //! After calling this method, calling unsubscribe() or destroying the
     //! subscription instance will have no effect.
     //!
-    //! \return Functor taking no parameters that will perform the unsubscribe
-    //!         when called.
+    //! \return Move-only functor taking no parameters that will perform the
+    //!         unsubscribe when called.
     //!         For example: ``subscription.release()()`` is equivalent to
     //!         ``subscription.unsubscribe()``.
     auto release()
@@ -68,18 +74,34 @@ public:
     auto operator=(infinite_subscription const &) -> infinite_subscription & =delete;
 
     //! This class is move-constructible.
-    infinite_subscription(infinite_subscription &&) = default;
+    //!
+    //! Unsubscribing the moved-from instance will have no effect.
+    infinite_subscription(infinite_subscription && other) noexcept :
+        unsubscribe_ { std::move(other.unsubscribe_) },
+        called_ { other.called_.exchange(true) }
+    { }
 
     //! This class is move-assignable.
-    auto operator=(infinite_subscription &&) -> infinite_subscription & =default;
+    //!
+    //! Unsubscribing the moved-from instance will have no effect.
+    auto operator=(infinite_subscription && other) noexcept -> infinite_subscription &
+    {
+        if(this != &other)
+        {
+            unsubscribe_ = std::move(other.unsubscribe_);
+            called_.store(other.called_.exchange(true));
+        }
+
+        return *this;
+    }
 
 private:
-    std::function<void()> unsubscribe_ { []() { } };
+    detail::small_function<void()> unsubscribe_ { []() { } };
 
     // std::call_once with a std::once_flag would have worked, but it requires
     // pthreads on Linux. We're using this in order not to bring in that
-    // dependency.
-    std::unique_ptr<std::atomic_flag> called_ { std::make_unique<std::atomic_flag>() };
+    // dependency. The flag is stored inline, so moves are written by hand.
+    std::atomic<bool> called_ { false };
 };
 
 //! Unsubscribe the associated observer when destroyed.
@@ -0,0 +1,138 @@
+#pragma once
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <utility>
+
+namespace observable {
+
+//! Source of time and delayed execution used by time-based operators.
+//!
+//! Implement this interface to plug the time-based operators (throttle(),
+//! debounce(), sample_every() and buffer_for()) into an existing event loop.
+//! An implementation will usually forward schedule() to the event loop's
+//! delayed task facility and return the loop's monotonic clock from now().
+//!
+//! \warning Implementations must be safe to call from multiple threads; the
+//!          operators call schedule() from whatever thread notifies their
+//!          source values.
+//!
+//! \ingroup observable
+class timer_source
+{
+public:
+    //! Clock used to measure time intervals.
+    using clock = std::chrono::steady_clock;
+
+    //! Time point type returned by now().
+    using time_point = clock::time_point;
+
+    //! Duration type used for delays.
+    using duration = clock::duration;
+
+    //! Task type accepted by schedule().
+    using task = std::function<void()>;
+
+    //! Return the current time.
+    virtual auto now() const -> time_point =0;
+
+    //! Run the provided task once, after the provided delay has elapsed.
+    //!
+    //! \param[in] delay Minimum amount of time to wait before running the task.
+    //!                  A zero delay means the task should run as soon as
+    //!                  possible, but never from inside this call.
+    //! \param[in] t Task to run.
+    virtual void schedule(duration delay, task t) =0;
+
+    //! Destructor.
+    virtual ~timer_source() { }
+};
+
+//! Timer source that only advances when told to.
+//!
+//! Scheduled tasks are run, in the order of their due time, by run_due() and
+//! advance(). This is useful for driving time-based operators from a polling
+//! loop, or for deterministic tests.
+//!
+//! \note All methods of this class can be safely called in parallel, from
+//!       multiple threads.
+//!
+//! \ingroup observable
+class manual_timer final : public timer_source
+{
+public:
+    //! Create a timer whose current time is the provided time point.
+    explicit manual_timer(time_point start = time_point { }) : now_ { start }
+    { }
+
+    virtual auto now() const -> time_point override
+    {
+        std::lock_guard<std::mutex> const lock { mutex_ };
+        return now_;
+    }
+
+    virtual void schedule(duration delay, task t) override
+    {
+        std::lock_guard<std::mutex> const lock { mutex_ };
+        tasks_.emplace(std::make_pair(now_ + delay, next_seq_++), std::move(t));
+    }
+
+    //! Move the current time forward and run any tasks that became due.
+    //!
+    //! \param[in] d Amount of time to move forward.
+    void advance(duration d)
+    {
+        {
+            std::lock_guard<std::mutex> const lock { mutex_ };
+            now_ += d;
+        }
+
+        run_due();
+    }
+
+    //! Run all tasks that are due at the current time.
+    //!
+    //! Tasks scheduled by running tasks will also be run if they are due.
+    void run_due()
+    {
+        for(;;)
+        {
+            task t;
+            {
+                std::lock_guard<std::mutex> const lock { mutex_ };
+                auto const it = tasks_.begin();
+                if(it == tasks_.end() || it->first.first > now_)
+                    return;
+
+                t = std::move(it->second);
+                tasks_.erase(it);
+            }
+
+            t();
+        }
+    }
+
+    //! Return the number of tasks waiting to be run.
+    auto pending() const -> std::size_t
+    {
+        std::lock_guard<std::mutex> const lock { mutex_ };
+        return tasks_.size();
+    }
+
+public:
+    //! Manual timers are not copy-constructible.
+    manual_timer(manual_timer const &) =delete;
+
+    //! Manual timers are not copy-assignable.
+    auto operator=(manual_timer const &) -> manual_timer & =delete;
+
+private:
+    mutable std::mutex mutex_;
+    time_point now_;
+    std::uint64_t next_seq_ { 0 };
+    std::map<std::pair<time_point, std::uint64_t>, task> tasks_;
+};
+
+}
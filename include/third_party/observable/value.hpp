@@ -108,6 +108,7 @@ public:
     //! \param ud A value_updater that will be stored by the value.
     template <typename UpdaterType>
     explicit value(std::unique_ptr<UpdaterType> && ud) :
+        value_ { },
         updater_ { std::move(ud) }
     {
         using namespace std::placeholders;
@@ -118,6 +119,29 @@ public:
         set_impl(updater_->get());
     }
 
+    //! Create an initialized value that will be updated by the provided
+    //! value_updater, using a custom comparator.
+    //!
+    //! \param ud A value_updater that will be stored by the value.
+    //! \param equal A functor to be used for comparing values. The functor must
+    //!              have a signature compatible with the one below:
+    //!
+    //!                 bool(ValueType const &, ValueType const &)
+    //!
+    //!              The comparator must return true if both of its parameters
+    //!              are equal.
+    template <typename UpdaterType, typename EqualityComparator>
+    value(std::unique_ptr<UpdaterType> && ud, EqualityComparator equal) :
+        value_ { },
+        eq_ { std::move(equal) },
+        updater_ { std::move(ud) }
+    {
+        updater_->set_value_notifier(std::bind(&value<ValueType>::set_impl,
+                                               this,
+                                               std::placeholders::_1));
+        set_impl(updater_->get());
+    }
+
     //! Convert the observable value to its stored value type.
     explicit operator ValueType const &() const noexcept { return value_; }
 
@@ -0,0 +1,415 @@
+#pragma once
+#include <algorithm>
+#include <cassert>
+#include <cstddef>
+#include <functional>
+#include <initializer_list>
+#include <iterator>
+#include <type_traits>
+#include <utility>
+#include <vector>
+#include <observable/subject.hpp>
+#include <observable/subscription.hpp>
+#include <observable/detail/type_traits.hpp>
+
+namespace observable {
+
+//! Kind of change reported by observable containers.
+//!
+//! \ingroup observable
+enum class change_kind
+{
+    inserted, //!< Elements have been inserted.
+    erased,   //!< Elements have been erased.
+    updated   //!< Elements have been assigned a new value.
+};
+
+//! A range of elements affected by a change to an observable \ref vector.
+//!
+//! \ingroup observable
+struct index_range_change
+{
+    //! What happened to the elements.
+    change_kind kind;
+
+    //! Index of the first affected element.
+    //!
+    //! For erased elements, this is the index the elements had before being
+    //! erased; for inserted and updated elements, the index they have after the
+    //! change.
+    std::size_t first;
+
+    //! Number of affected elements.
+    std::size_t count;
+
+    //! Changes are equal if they have the same kind and range.
+    auto operator==(index_range_change const & other) const noexcept
+    {
+        return kind == other.kind && first == other.first && count == other.count;
+    }
+};
+
+//! Ordered list of changes made to an observable \ref vector.
+//!
+//! Applying the changes in order, to a copy of the vector as it was before the
+//! changes, produces the vector as it is after the changes.
+//!
+//! \ingroup observable
+using index_change_set = std::vector<index_range_change>;
+
+//! Vector that notifies observers of the ranges that changed.
+//!
+//! Observers receive compact change sets describing which elements have been
+//! inserted, erased or updated, instead of the whole vector. Views can use them
+//! to update only the affected items.
+//!
+//! Each mutation produces one change set, unless mutations are batched. All the
+//! mutations made while a batch is alive produce a single change set, in which
+//! adjacent changes of the same kind are merged:
+//!
+//!     {
+//!         auto const b = items.batch();
+//!         items.push_back(1);
+//!         items.push_back(2);
+//!     } // Observers are called once, with { inserted, first, 2 }.
+//!
+//! \warning None of the methods in this class can be safely called concurrently.
+//!
+//! \tparam ValueType Type of the elements.
+//!
+//! \ingroup observable
+template <typename ValueType>
+class vector
+{
+    using void_subject = subject<void()>;
+    using changes_subject = subject<void(index_change_set const &)>;
+
+public:
+    //! Type of the stored elements.
+    using value_type = ValueType;
+
+    //! Type used for sizes and indices.
+    using size_type = std::size_t;
+
+    //! Read-only iterator.
+    using const_iterator = typename std::vector<ValueType>::const_iterator;
+
+    //! Change set type passed to observers.
+    using change_set = index_change_set;
+
+    //! Keep mutations batched for the duration of an instance's lifetime.
+    //!
+    //! Batches can be nested; the change set is delivered when the outermost
+    //! batch is destroyed.
+    class batch_guard
+    {
+    public:
+        explicit batch_guard(vector<ValueType> & v) noexcept : vector_ { &v }
+        {
+            ++vector_->batch_depth_;
+        }
+
+        ~batch_guard()
+        {
+            if(vector_ && --vector_->batch_depth_ == 0)
+                vector_->flush();
+        }
+
+        batch_guard(batch_guard const &) =delete;
+        auto operator=(batch_guard const &) -> batch_guard & =delete;
+
+        batch_guard(batch_guard && other) noexcept : vector_ { other.vector_ }
+        {
+            other.vector_ = nullptr;
+        }
+
+        auto operator=(batch_guard &&) -> batch_guard & =delete;
+
+    private:
+        vector<ValueType> * vector_;
+    };
+
+public:
+    //! Create an empty vector.
+    vector() =default;
+
+    //! Create a vector with the provided elements.
+    explicit vector(std::vector<ValueType> initial) :
+        items_ { std::move(initial) }
+    { }
+
+    //! Create a vector with the provided elements.
+    vector(std::initializer_list<ValueType> initial) :
+        items_ { initial }
+    { }
+
+    //! Retrieve the stored elements.
+    auto get() const noexcept -> std::vector<ValueType> const & { return items_; }
+
+    //! Return the number of elements.
+    auto size() const noexcept { return items_.size(); }
+
+    //! Return true if the vector has no elements.
+    auto empty() const noexcept { return items_.empty(); }
+
+    //! Retrieve an element.
+    auto operator[](size_type i) const -> ValueType const & { return items_[i]; }
+
+    //! Retrieve an element, with bounds checking.
+    auto at(size_type i) const -> ValueType const & { return items_.at(i); }
+
+    //! Return an iterator to the first element.
+    auto begin() const noexcept { return items_.cbegin(); }
+
+    //! Return an iterator past the last element.
+    auto end() const noexcept { return items_.cend(); }
+
+    //! Subscribe to changes to the vector.
+    //!
+    //! \param[in] observer A callable that will be called after the vector
+    //!                     changes.
+    //!
+    //! \tparam Callable A callable taking no parameters, or a callable taking
+    //!                  a ``change_set const &``.
+    //!
+    //! \see subject<void(Args ...)>::subscribe()
+    template <typename Callable>
+    auto subscribe(Callable && observer) const
+    {
+        static_assert(detail::is_compatible_with_subject<Callable, void_subject>::value ||
+                      detail::is_compatible_with_subject<Callable, changes_subject>::value,
+                      "Observer is not valid. Please provide a void observer or an "
+                      "observer that takes a change_set as its only argument.");
+
+        return subscribe_impl(std::forward<Callable>(observer));
+    }
+
+    //! Start a batch of mutations.
+    //!
+    //! \return A guard that delivers the batched changes when destroyed.
+    auto batch() { return batch_guard { *this }; }
+
+    //! Append an element.
+    void push_back(ValueType v)
+    {
+        items_.push_back(std::move(v));
+        record(change_kind::inserted, items_.size() - 1, 1);
+    }
+
+    //! Insert an element before the element at the provided index.
+    void insert(size_type index, ValueType v)
+    {
+        assert(index <= items_.size());
+        items_.insert(items_.begin() + index, std::move(v));
+        record(change_kind::inserted, index, 1);
+    }
+
+    //! Insert a range of elements before the element at the provided index.
+    template <typename InputIt>
+    void insert(size_type index, InputIt first, InputIt last)
+    {
+        assert(index <= items_.size());
+        auto const old_size = items_.size();
+        items_.insert(items_.begin() + index, first, last);
+        record(change_kind::inserted, index, items_.size() - old_size);
+    }
+
+    //! Erase ``count`` elements, starting with the one at the provided index.
+    void erase(size_type index, size_type count = 1)
+    {
+        assert(index + count <= items_.size());
+        items_.erase(items_.begin() + index, items_.begin() + index + count);
+        record(change_kind::erased, index, count);
+    }
+
+    //! Remove the last element.
+    void pop_back()
+    {
+        assert(!items_.empty());
+        erase(items_.size() - 1);
+    }
+
+    //! Assign a new value to the element at the provided index.
+    //!
+    //! Nothing is recorded if the new value compares equal to the old one.
+    void set(size_type index, ValueType v)
+    {
+        assert(index < items_.size());
+        if(equal(items_[index], v))
+            return;
+
+        items_[index] = std::move(v);
+        record(change_kind::updated, index, 1);
+    }
+
+    //! Modify the element at the provided index in-place.
+    //!
+    //! \param[in] index Index of the element to modify.
+    //! \param[in] fun Callable that will be called with a reference to the
+    //!                element. The element is always reported as updated.
+    template <typename UnaryFunctor>
+    void modify(size_type index, UnaryFunctor && fun)
+    {
+        assert(index < items_.size());
+        fun(items_[index]);
+        record(change_kind::updated, index, 1);
+    }
+
+    //! Erase all elements.
+    void clear()
+    {
+        auto const count = items_.size();
+        items_.clear();
+        record(change_kind::erased, 0, count);
+    }
+
+    //! Replace all elements.
+    void assign(std::vector<ValueType> items)
+    {
+        auto const b = batch();
+        clear();
+        auto const count = items.size();
+        items_ = std::move(items);
+        record(change_kind::inserted, 0, count);
+    }
+
+public:
+    //! Observable vectors are **not** copy-constructible.
+    vector(vector const &) =delete;
+
+    //! Observable vectors are **not** copy-assignable.
+    auto operator=(vector const &) -> vector & =delete;
+
+    //! Observable vectors are move-constructible.
+    vector(vector &&) =default;
+
+    //! Observable vectors are move-assignable.
+    auto operator=(vector &&) -> vector & =default;
+
+private:
+    template <typename Callable>
+    auto subscribe_impl(Callable && observer) const ->
+        std::enable_if_t<detail::is_compatible_with_subject<Callable, void_subject>::value &&
+                         !detail::is_compatible_with_subject<Callable, changes_subject>::value,
+                         infinite_subscription>
+    {
+        return void_observers_.subscribe(std::forward<Callable>(observer));
+    }
+
+    template <typename Callable>
+    auto subscribe_impl(Callable && observer) const ->
+        std::enable_if_t<detail::is_compatible_with_subject<Callable,
+                                                            changes_subject>::value,
+                         infinite_subscription>
+    {
+        return changes_observers_.subscribe(std::forward<Callable>(observer));
+    }
+
+    template <typename A>
+    static auto equal(A const & a, A const & b)
+        -> std::enable_if_t<detail::are_equality_comparable<A, A>::value, bool>
+    {
+        return a == b;
+    }
+
+    template <typename A>
+    static auto equal(A const &, A const &)
+        -> std::enable_if_t<!detail::are_equality_comparable<A, A>::value, bool>
+    {
+        return false;
+    }
+
+    //! Record a change and deliver it, unless a batch is active.
+    void record(change_kind kind, size_type first, size_type count)
+    {
+        if(count == 0)
+            return;
+
+        if(!merge(kind, first, count))
+            pending_.push_back(index_range_change { kind, first, count });
+
+        if(batch_depth_ == 0)
+            flush();
+    }
+
+    //! Try to merge a change into the last pending one.
+    auto merge(change_kind kind, size_type first, size_type count) -> bool
+    {
+        if(pending_.empty())
+            return false;
+
+        auto & last = pending_.back();
+        auto const last_end = last.first + last.count;
+
+        switch(kind)
+        {
+        case change_kind::inserted:
+            // Inserting anywhere inside, or right after, a block that was just
+            // inserted keeps the block contiguous.
+            if(last.kind != change_kind::inserted ||
+               first < last.first || first > last_end)
+                return false;
+
+            last.count += count;
+            return true;
+
+        case change_kind::erased:
+            if(last.kind != change_kind::erased)
+                return false;
+
+            if(first == last.first)
+            {
+                last.count += count;
+                return true;
+            }
+
+            if(first + count == last.first)
+            {
+                last.first = first;
+                last.count += count;
+                return true;
+            }
+
+            return false;
+
+        case change_kind::updated:
+            // Updating an element that was just inserted is already covered by
+            // the insertion.
+            if(last.kind == change_kind::inserted)
+                return first >= last.first && first + count <= last_end;
+
+            if(last.kind != change_kind::updated ||
+               first > last_end || first + count < last.first)
+                return false;
+
+            auto const end = std::max(last_end, first + count);
+            last.first = std::min(last.first, first);
+            last.count = end - last.first;
+            return true;
+        }
+
+        return false;
+    }
+
+    //! Deliver pending changes.
+    void flush()
+    {
+        if(pending_.empty())
+            return;
+
+        change_set changes;
+        changes.swap(pending_);
+        void_observers_.notify();
+        changes_observers_.notify(changes);
+    }
+
+private:
+    std::vector<ValueType> items_;
+    change_set pending_;
+    std::size_t batch_depth_ = 0;
+
+    mutable void_subject void_observers_;
+    mutable changes_subject changes_observers_;
+};
+
+}
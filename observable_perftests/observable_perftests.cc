@@ -0,0 +1,210 @@
+// This file is published under public domain.
+//
+// Micro-benchmarks for the observable library. Results are printed through
+// perf_test::PrintResult, one line per data point, e.g.:
+//
+//   *RESULT notify: subscribers_100= 412.5 ns_per_op
+//
+// Every benchmark runs its body repeatedly until at least kMinRunTime has
+// passed, and reports the mean time per operation.
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "perftests/perf_harness.h"
+
+#include <observable/observable.hpp>
+
+namespace {
+
+using perftests::Clock;
+using perftests::kMinRunTime;
+using perftests::Report;
+using perftests::TimePerIteration;
+
+// Keeps the optimizer from discarding benchmarked work.
+std::atomic<std::uint64_t> g_sink{0};
+
+// subject::notify() cost as the number of subscribers grows.
+void NotifyThroughput() {
+  for (std::size_t subscribers : {0, 1, 10, 100, 1000}) {
+    observable::subject<void(int)> subject;
+    std::vector<observable::unique_subscription> subs;
+    std::uint64_t sum = 0;
+    for (std::size_t i = 0; i < subscribers; ++i)
+      subs.emplace_back(subject.subscribe([&sum](int v) { sum += v; }));
+
+    double ns = TimePerIteration([&](std::size_t n) {
+      for (std::size_t i = 0; i < n; ++i)
+        subject.notify(static_cast<int>(i));
+    });
+    g_sink += sum;
+
+    std::string trace = "subscribers_" + std::to_string(subscribers);
+    Report("notify", trace, ns, "ns_per_op");
+    if (subscribers > 0)
+      Report("notify_per_observer", trace, ns / subscribers, "ns_per_call");
+  }
+}
+
+// value::set() cost with the equality check, for a value that changes on
+// every call and for one that is always set to its current contents.
+template <typename T>
+void SetWithCompare(const std::string& name, T a, T b) {
+  observable::value<T> val{a};
+  auto sub = val.subscribe([](const T&) { ++g_sink; });
+
+  double changing = TimePerIteration([&](std::size_t n) {
+    for (std::size_t i = 0; i < n; ++i)
+      val.set(i % 2 ? a : b);
+  });
+  Report("value_set", name + "_changed", changing, "ns_per_op");
+
+  val.set(a);
+  double unchanged = TimePerIteration([&](std::size_t n) {
+    for (std::size_t i = 0; i < n; ++i)
+      val.set(a);
+  });
+  Report("value_set", name + "_unchanged", unchanged, "ns_per_op");
+}
+
+void ValueSet() {
+  SetWithCompare<int>("int", 1, 2);
+
+  std::array<double, 16> small_a{}, small_b{};
+  small_b.back() = 1;
+  SetWithCompare("array16", small_a, small_b);
+
+  // Equal prefix, so the comparison has to look at the whole value.
+  std::vector<double> large_a(4096, 1.0), large_b(4096, 1.0);
+  large_b.back() = 2.0;
+  SetWithCompare("vector4096", large_a, large_b);
+}
+
+// subscribe()/unsubscribe() pairs per second with several threads hammering
+// the same subject, while another thread keeps notifying it.
+void SubscriptionChurn() {
+  for (std::size_t threads : {1, 2, 4, 8}) {
+    observable::subject<void()> subject;
+    std::atomic<bool> stop{false};
+    std::atomic<std::uint64_t> ops{0};
+
+    std::thread notifier([&] {
+      while (!stop)
+        subject.notify();
+    });
+
+    std::vector<std::thread> churners;
+    for (std::size_t t = 0; t < threads; ++t) {
+      churners.emplace_back([&] {
+        std::uint64_t local = 0;
+        while (!stop) {
+          auto sub = subject.subscribe([] { ++g_sink; });
+          sub.unsubscribe();
+          ++local;
+        }
+        ops += local;
+      });
+    }
+
+    auto const start = Clock::now();
+    std::this_thread::sleep_for(kMinRunTime);
+    stop = true;
+    for (auto& t : churners)
+      t.join();
+    notifier.join();
+    auto const elapsed =
+        std::chrono::duration<double>(Clock::now() - start).count();
+
+    Report("subscription_churn", "threads_" + std::to_string(threads),
+           ops / elapsed, "ops_per_s");
+  }
+}
+
+// Evaluation of a chain of |depth| unary nodes over a single value.
+void ExpressionDepth() {
+  using observable::expr::expression_node;
+  for (std::size_t depth : {1, 4, 16, 64}) {
+    observable::updater ud;
+    observable::value<int> source{0};
+
+    expression_node<int> node{source};
+    for (std::size_t i = 0; i < depth; ++i)
+      node = expression_node<int>{[](int v) { return v + 1; }, std::move(node)};
+    auto result = observable::observe(ud, std::move(node));
+
+    double ns = TimePerIteration([&](std::size_t n) {
+      for (std::size_t i = 0; i < n; ++i) {
+        source.set(static_cast<int>(i));
+        ud.update_all();
+      }
+    });
+    g_sink += result.get();
+
+    Report("expression_depth", "depth_" + std::to_string(depth), ns,
+           "ns_per_update");
+  }
+}
+
+// Builds a balanced tree of additions over |leaves|.
+observable::expr::expression_node<int> SumTree(
+    std::vector<observable::value<int>>& leaves,
+    std::size_t first,
+    std::size_t count) {
+  using observable::expr::expression_node;
+  if (count == 1)
+    return expression_node<int>{leaves[first]};
+
+  std::size_t half = count / 2;
+  return expression_node<int>{[](int a, int b) { return a + b; },
+                              SumTree(leaves, first, half),
+                              SumTree(leaves, first + half, count - half)};
+}
+
+// Evaluation of a tree over |width| values, when one value changes (only its
+// path is re-evaluated) and when all of them change.
+void ExpressionWidth() {
+  for (std::size_t width : {2, 16, 128, 1024}) {
+    observable::updater ud;
+    std::vector<observable::value<int>> leaves(width);
+    auto result = observable::observe(ud, SumTree(leaves, 0, width));
+
+    double one = TimePerIteration([&](std::size_t n) {
+      for (std::size_t i = 0; i < n; ++i) {
+        leaves[i % width].set(static_cast<int>(i));
+        ud.update_all();
+      }
+    });
+
+    double all = TimePerIteration([&](std::size_t n) {
+      for (std::size_t i = 0; i < n; ++i) {
+        for (auto& leaf : leaves)
+          leaf.set(static_cast<int>(i));
+        ud.update_all();
+      }
+    });
+    g_sink += result.get();
+
+    std::string trace = "width_" + std::to_string(width);
+    Report("expression_width_one_changed", trace, one, "ns_per_update");
+    Report("expression_width_all_changed", trace, all, "ns_per_update");
+  }
+}
+
+}  // namespace
+
+int main() {
+  NotifyThroughput();
+  ValueSet();
+  SubscriptionChurn();
+  ExpressionDepth();
+  ExpressionWidth();
+  return 0;
+}
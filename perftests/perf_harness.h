@@ -0,0 +1,52 @@
+// Copyright 2018 Cheng Zhao. All rights reserved.
+// Use of this source code is governed by the license that can be found in the
+// LICENSE file.
+//
+// Timing and reporting shared by the benchmark suites. Every benchmark runs
+// its body repeatedly until at least kMinRunTime has passed, and reports the
+// mean through perf_test::PrintResult.
+
+#ifndef PERFTESTS_PERF_HARNESS_H_
+#define PERFTESTS_PERF_HARNESS_H_
+
+#include <chrono>
+#include <cstddef>
+#include <string>
+#include <utility>
+
+#include "testing/perf/perf_test.h"
+
+namespace perftests {
+
+using Clock = std::chrono::steady_clock;
+
+constexpr auto kMinRunTime = std::chrono::milliseconds(200);
+
+// Calls |body| with increasing iteration counts until a run takes at least
+// kMinRunTime. Returns the mean time, in nanoseconds, per iteration.
+template <typename Body>
+double TimePerIteration(Body&& body) {
+  std::size_t iterations = 1;
+  for (;;) {
+    auto const start = Clock::now();
+    body(iterations);
+    auto const elapsed = Clock::now() - start;
+    if (elapsed >= kMinRunTime || iterations >= (std::size_t{1} << 30)) {
+      auto const ns =
+          std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed);
+      return static_cast<double>(ns.count()) / iterations;
+    }
+    iterations *= 2;
+  }
+}
+
+inline void Report(const std::string& measurement,
+                   const std::string& trace,
+                   double value,
+                   const std::string& units) {
+  perf_test::PrintResult(measurement, "", trace, value, units, true);
+}
+
+}  // namespace perftests
+
+#endif  // PERFTESTS_PERF_HARNESS_H_
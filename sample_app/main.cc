@@ -9,6 +9,7 @@
 //#include "radar_view.h"
 
 #include "base/command_line.h"
+#include "base/time/time.h"
 // #include "string_number_conversions.h"
 
 #include "nativeui/nativeui.h"
@@ -27,6 +28,26 @@ struct SonarData
     float right;
 };
 
+// Runs observable's time-based operators on the GUI message loop, so throttled
+// values always change on the UI thread.
+class MessageLoopTimer : public observable::timer_source
+{
+public:
+  time_point now() const override
+  {
+    base::TimeDelta since_origin = base::TimeTicks::Now() - base::TimeTicks();
+    return time_point(std::chrono::microseconds(since_origin.InMicroseconds()));
+  }
+
+  void schedule(duration delay, task t) override
+  {
+    // Round up, tasks must never run before their delay has elapsed.
+    auto ms = std::chrono::duration_cast<std::chrono::milliseconds>(
+        delay + std::chrono::milliseconds(1) - duration(1));
+    nu::MessageLoop::PostDelayedTask(static_cast<int>(ms.count()), t);
+  }
+};
+
 const static float pi = 3.1415926;
 static const float window_width = 600;
 static const float window_height = 600;
@@ -214,7 +235,12 @@ int main(int argc, const char *argv[]) {
   // Create window with default options, and then show it.
   scoped_refptr<nu::Window> window(new nu::Window(nu::Window::Options()));
 
-  model.dataHB.subscribe([&](auto hb){
+  // Repaint at most 30 times per second, however fast the model updates.
+  MessageLoopTimer ui_timer;
+  auto repaint = observable::throttle(model.dataHB,
+                                      std::chrono::milliseconds(33),
+                                      ui_timer);
+  repaint.subscribe([&](auto hb){
     window->GetContentView()->Layout();
     window->GetContentView()->SchedulePaint();
   }); 